@@ -0,0 +1,230 @@
+/**
+ * @file adaptive_encoder.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class encoding a file in blocks, each with its own table of codes
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "adaptive_encoder.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "huffman_tree.hpp"
+#include "bit_writer.hpp"
+#include "histogram.hpp"
+
+
+/**
+ * @brief Construct a new Adaptive Encoder:: Adaptive Encoder object
+ *
+ * @param filename path of the file to encode
+ * @param block_size number of characters of each block, must be positive
+ * @param n_threads number of threads to use, must be positive
+ * @param max_length maximum length of the codes, 0 if not limited
+ */
+AdaptiveEncoder::AdaptiveEncoder(const std::string &filename, uint64_t block_size, int n_threads, int max_length) : file(filename){
+    this->filesize = file.size();
+    this->block_size = block_size;
+    this->n_threads = n_threads;
+    this->max_length = max_length;
+}
+
+/**
+ * @brief method computing the number of blocks the file is split in, an empty file still has one empty block
+ *
+ * @return int
+ */
+int AdaptiveEncoder::getNBlocks(){return std::max(uint64_t(1), (filesize + block_size - 1) / block_size);}
+/**
+ * @brief getter method for the number of characters of each block apart from the last one
+ *
+ * @return uint64_t
+ */
+uint64_t AdaptiveEncoder::getBlockSize(){return block_size;}
+/**
+ * @brief getter method for the number of tables written in the last encoding, the other blocks reuse them
+ *
+ * @return int
+ */
+int AdaptiveEncoder::getNTables(){return n_tables;}
+/**
+ * @brief getter method for the time spent reading the file
+ *
+ * @return long
+ */
+long AdaptiveEncoder::getReadTime(){return read_time;}
+/**
+ * @brief getter method for the time spent counting the characters and building the codes
+ *
+ * @return long
+ */
+long AdaptiveEncoder::getFreqTime(){return freq_time;}
+/**
+ * @brief getter method for the time spent encoding
+ *
+ * @return long
+ */
+long AdaptiveEncoder::getEncodeTime(){return encode_time;}
+/**
+ * @brief getter method for the time spent writing the output
+ *
+ * @return long
+ */
+long AdaptiveEncoder::getWriteTime(){return write_time;}
+/**
+ * @brief getter method for the cost of limiting the length of the codes of the tables built in the last encoding
+ *
+ * @return LengthLimitReport&
+ */
+LengthLimitReport &AdaptiveEncoder::getLimitReport(){return limit_report;}
+
+/**
+ * @brief method reading a block of the file with a positional read
+ *
+ * @param block index of the block
+ * @param buffer buffer to store the block in, resized to the size of the block
+ * @return true if the whole block was read
+ * @return false otherwise
+ */
+bool AdaptiveEncoder::read_block(int block, std::vector<unsigned char> &buffer){
+    uint64_t offset = block * block_size;
+    buffer.resize(std::min(block_size, filesize - offset));
+    return file.read(offset, buffer.size(), buffer.data());
+}
+
+/**
+ * @brief method encoding the file and writing it after the header
+ *
+ * Blocks are assigned to threads dynamically through a shared counter. Once the codes of a block are built,
+ * the thread waits for the table of the previous block to be chosen, then chooses the table of its block and
+ * computes the position of the block in the output file from its exact size. Encoding and writing happen
+ * after that without any further ordering.
+ *
+ * @param header adaptive header of the encoded file, used to write the header of each chunk
+ * @param output file to write to
+ * @param offset position of the first block in the output file, after the header of the file
+ * @return true if the whole file was read and written
+ * @return false otherwise
+ */
+bool AdaptiveEncoder::encode(FileHeader &header, OutputFile &output, uint64_t offset){
+    read_time = 0;
+    freq_time = 0;
+    encode_time = 0;
+    write_time = 0;
+    n_tables = 0;
+    limit_report.reset();
+    std::atomic<int> next_block = 0;
+    std::atomic<bool> failed = false;
+    int n_blocks = getNBlocks();
+    // tracks the next block whose table has to be chosen, with the table in use and the end of the output
+    int table_id = 0;
+    std::vector<int> current_lengths;
+    uint64_t next_offset = offset;
+    std::mutex m;
+    std::condition_variable cv;
+
+    auto encode_blocks = [&](int tid){
+        Timer timer;
+        std::vector<unsigned char> buffer;
+        std::vector<uint64_t> block_counts;
+        std::vector<char> output_buf;
+        bool ok = file.is_open() && output.is_open();
+
+        for(int i = next_block++; i < n_blocks; i = next_block++){
+            std::vector<int> code_lengths;
+            if(ok && !failed){
+                timer.start("reading_input");
+                ok = read_block(i, buffer);
+                read_time += timer.stop();
+
+                timer.start("freq_time");
+                block_counts.assign(256, 0);
+                count_bytes(buffer.data(), buffer.size(), block_counts);
+                HuffmanTree ht(block_counts, max_length);
+                code_lengths = ht.getCodeLengths();
+                limit_report.add(ht, block_counts);
+                freq_time += timer.stop();
+            }
+            if(!ok){
+                failed = true;
+            }
+
+            // choose the table in order, blocks are still taken in turn after a failure so that no thread waits forever
+            bool own_table = true;
+            bool raw = false;
+            uint64_t block_offset = 0;
+            uint64_t n_bits = 0;
+            {
+                std::unique_lock lk(m);
+                while(i != table_id){
+                    cv.wait(lk);
+                }
+                if(!failed){
+                    uint64_t own_bits, reused_bits;
+                    HuffmanTree::tableBits(block_counts, code_lengths, own_bits);
+                    uint64_t table_bits = 8 * (header.serializeChunk(0, 0, &code_lengths).size() - header.serializeChunk(0, 0).size());
+                    own_bits += table_bits;
+                    // the first block has no previous table, and the previous table may lack some characters
+                    if(i > 0 && HuffmanTree::tableBits(block_counts, current_lengths, reused_bits)
+                            && reused_bits * 100 <= own_bits * (100 + REUSE_TOLERANCE)){
+                        own_table = false;
+                        code_lengths = current_lengths;
+                        n_bits = reused_bits;
+                    }
+                    else{
+                        HuffmanTree::tableBits(block_counts, code_lengths, n_bits);
+                    }
+                    // blocks which would not shrink are stored raw without codes, the next blocks keep the previous table
+                    raw = header.storeRaw(n_bits + (own_table ? table_bits : 0), buffer.size());
+                    if(raw){
+                        own_table = false;
+                    }
+                    else if(own_table){
+                        current_lengths = code_lengths;
+                        n_tables++;
+                    }
+                    block_offset = next_offset;
+                    next_offset += header.serializeChunk(0, 0, own_table ? &code_lengths : nullptr).size()
+                                    + (raw ? buffer.size() : BitWriter::byte_size(n_bits));
+                }
+                table_id++;
+                cv.notify_all();
+            }
+            if(failed){
+                continue;
+            }
+
+            // the chunk is encoded after the room for its header, which is filled once the encoding is known
+            // since it may store its checksum, so that the chunk is written with a single call
+            timer.start("encode");
+            uint64_t chunk_size = raw ? buffer.size() : BitWriter::byte_size(n_bits);
+            char padding = raw ? FileHeader::RAW_CHUNK : BitWriter::padding(n_bits);
+            size_t chunk_header_size = header.serializeChunk(chunk_size, padding, own_table ? &code_lengths : nullptr).size();
+            output_buf.resize(chunk_header_size + (raw ? buffer.size() : BitWriter::buffer_size(n_bits)));
+            if(raw){
+                std::copy(buffer.begin(), buffer.end(), output_buf.begin() + chunk_header_size);
+            }
+            else{
+                BitWriter writer(HuffmanTree::canonicalCodes(code_lengths));
+                writer.encode(buffer.data(), buffer.size(), output_buf.data() + chunk_header_size);
+            }
+            auto chunk_header = header.serializeChunk(chunk_size, padding, own_table ? &code_lengths : nullptr, 0,
+                                                        output_buf.data() + chunk_header_size);
+            std::copy(chunk_header.begin(), chunk_header.end(), output_buf.begin());
+            encode_time += timer.stop();
+
+            timer.start("write");
+            if(!output.write(block_offset, output_buf.data(), chunk_header.size() + chunk_size)){
+                failed = true;
+            }
+            write_time += timer.stop();
+        }
+    };
+
+    ThreadPool::shared(n_threads).run(encode_blocks);
+    return !failed;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file adaptive_encoder.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class encoding a file in blocks, each with its own table of codes
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+#include "file_header.hpp"
+#include "huffman_tree.hpp"
+#include "input_file.hpp"
+#include "output_file.hpp"
+
+
+/**
+ * @brief class encoding a file in fixed size blocks, building the codes of each block from its own frequencies
+ *
+ * The file is read once: each thread reads a block, counts its characters, builds its codes, encodes and writes it.
+ * There is no counting pass over the whole file, the only step taken in order is choosing the table of each block,
+ * which keeps the table of the previous block when its cost is close to the one of the codes of the block.
+ * The header must be built with getNBlocks chunks of getBlockSize characters and the adaptive version.
+ * Every thread holds at most one block and its encoding at a time, so the memory used only depends on the size
+ * of the blocks and on the number of threads.
+ *
+ */
+class AdaptiveEncoder{
+    private:
+        /**
+         * @brief file to encode, shared by all the threads
+         *
+         */
+        InputFile file;
+        /**
+         * @brief size of the file to encode in bytes
+         *
+         */
+        uint64_t filesize;
+        /**
+         * @brief number of characters of each block apart from the last one
+         *
+         */
+        uint64_t block_size;
+        /**
+         * @brief number of threads reading and encoding blocks
+         *
+         */
+        int n_threads;
+        /**
+         * @brief maximum length of the codes, 0 if not limited
+         *
+         */
+        int max_length;
+        /**
+         * @brief number of tables written in the last encoding
+         *
+         */
+        int n_tables = 0;
+        /**
+         * @brief time spent reading the file, summed between threads
+         *
+         */
+        std::atomic<long> read_time = 0;
+        /**
+         * @brief time spent counting and building the codes, summed between threads
+         *
+         */
+        std::atomic<long> freq_time = 0;
+        /**
+         * @brief time spent encoding, summed between threads
+         *
+         */
+        std::atomic<long> encode_time = 0;
+        /**
+         * @brief time spent writing the output, summed between threads
+         *
+         */
+        std::atomic<long> write_time = 0;
+        /**
+         * @brief cost of limiting the length of the codes of the tables built in the last encoding
+         *
+         */
+        LengthLimitReport limit_report;
+
+        bool read_block(int block, std::vector<unsigned char> &buffer);
+
+    public:
+        /**
+         * @brief a block keeps the table of the previous one if its encoding is at most this percentage larger
+         * than with its own codes and table. Reusing tables also saves building decoding tables
+         *
+         */
+        static const int REUSE_TOLERANCE = 1;
+
+        AdaptiveEncoder(const std::string &filename, uint64_t block_size, int n_threads, int max_length = 0);
+
+        int getNBlocks();
+        uint64_t getBlockSize();
+        int getNTables();
+        long getReadTime();
+        long getFreqTime();
+        long getEncodeTime();
+        long getWriteTime();
+        LengthLimitReport &getLimitReport();
+
+        bool encode(FileHeader &header, OutputFile &output, uint64_t offset);
+};
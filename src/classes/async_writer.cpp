@@ -0,0 +1,420 @@
+/**
+ * @file async_writer.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class writing parts of an output file asynchronously with io_uring
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "async_writer.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+
+/**
+ * @brief function writing a buffer at an offset, retrying until all of it is written
+ *
+ * @param fd descriptor of the file
+ * @param data bytes to write
+ * @param size number of bytes to write
+ * @param offset position of the first byte in the file
+ * @return true if all the bytes were written
+ * @return false otherwise
+ */
+static bool write_all(int fd, const char *data, size_t size, uint64_t offset){
+    size_t done = 0;
+    while(done < size){
+        ssize_t ret = pwrite(fd, data + done, size - done, offset + done);
+        if(ret < 0 && errno == EINTR){
+            continue;
+        }
+        if(ret <= 0){
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
+
+/**
+ * @brief Construct a new Async Writer:: Async Writer object, creating the buffers and the ring
+ *
+ * @param output_file file to write, must be open and stay open until the writer is destroyed
+ * @param filename path of the file, used to open it again in direct mode
+ * @param n_buffers number of buffers of the pool, must be positive
+ * @param buffer_size number of bytes each buffer must hold
+ * @param direct whether to bypass the page cache, ignored if the file system does not allow it
+ */
+AsyncWriter::AsyncWriter(OutputFile &output_file, const std::string &filename, int n_buffers, size_t buffer_size, bool direct){
+    fd = output_file.getFd();
+    if(direct){
+        direct_fd = open(filename.c_str(), O_WRONLY | O_DIRECT);
+    }
+
+    // the data of a buffer starts at the alignment of the offset it is written to, so a page is added to each buffer
+    stride = (buffer_size + 2 * ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    pool = static_cast<char *>(std::aligned_alloc(ALIGNMENT, stride * n_buffers));
+    buffer_writes.assign(n_buffers, 0);
+    for(int i=n_buffers-1; i>=0; i--){
+        free_buffers.push_back(i);
+    }
+    // in direct mode each buffer is written with up to three writes
+    writes.resize(3 * n_buffers);
+    for(int i=writes.size()-1; i>=0; i--){
+        free_writes.push_back(i);
+    }
+
+    if(!setup_ring(writes.size())){
+        close_ring();
+        return;
+    }
+    // registration fails if the buffers exceed the memory lock limit, they are then passed with each write
+    std::vector<iovec> iovecs(n_buffers);
+    for(int i=0; i<n_buffers; i++){
+        iovecs[i] = {pool + i * stride, stride};
+    }
+    registered = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), n_buffers) == 0;
+}
+
+/**
+ * @brief Destroy the Async Writer:: Async Writer object, waiting for the writes in flight
+ *
+ */
+AsyncWriter::~AsyncWriter(){
+    finish();
+    close_ring();
+    if(direct_fd >= 0){
+        close(direct_fd);
+    }
+    std::free(pool);
+}
+
+/**
+ * @brief method creating the ring and mapping its queues in memory
+ *
+ * @param entries minimum number of entries of the submission queue
+ * @return true if the ring can be used
+ * @return false otherwise
+ */
+bool AsyncWriter::setup_ring(unsigned entries){
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(ring_fd < 0){
+        return false;
+    }
+
+    // with a single mapping both queues are in the same memory
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if(single_mmap){
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if(sq_ring == MAP_FAILED){
+        sq_ring = nullptr;
+        return false;
+    }
+    cq_ring = single_mmap ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if(cq_ring == MAP_FAILED){
+        cq_ring = nullptr;
+        return false;
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if(sqes_ptr == MAP_FAILED){
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe *>(sqes_ptr);
+
+    char *sq = static_cast<char *>(sq_ring);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    char *cq = static_cast<char *>(cq_ring);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+/**
+ * @brief method releasing the ring and its mappings, writes are made synchronously afterwards
+ *
+ */
+void AsyncWriter::close_ring(){
+    if(sqes != nullptr){
+        munmap(sqes, sqes_size);
+        sqes = nullptr;
+    }
+    if(cq_ring != nullptr && cq_ring != sq_ring){
+        munmap(cq_ring, cq_ring_size);
+    }
+    cq_ring = nullptr;
+    if(sq_ring != nullptr){
+        munmap(sq_ring, sq_ring_size);
+        sq_ring = nullptr;
+    }
+    if(ring_fd >= 0){
+        close(ring_fd);
+        ring_fd = -1;
+    }
+    registered = false;
+}
+
+/**
+ * @brief method checking if writes are made asynchronously
+ *
+ * @return true if io_uring is used
+ * @return false if writes are made in submit
+ */
+bool AsyncWriter::isAsync(){return ring_fd >= 0;}
+/**
+ * @brief method checking if the buffers are registered in the kernel
+ *
+ * @return true if they are registered
+ * @return false otherwise
+ */
+bool AsyncWriter::isRegistered(){return registered;}
+/**
+ * @brief method checking if whole pages are written bypassing the page cache
+ *
+ * @return true if the file was opened with O_DIRECT
+ * @return false otherwise
+ */
+bool AsyncWriter::isDirect(){return direct_fd >= 0;}
+
+/**
+ * @brief method taking a free buffer from the pool, waiting for a write to complete if there is none
+ *
+ * @param offset position in the file of the first byte that will be written from the buffer
+ * @return char* start of the data in the buffer, at least buffer_size bytes can be written from it
+ */
+char *AsyncWriter::acquire(uint64_t offset){
+    std::unique_lock lk(m);
+    if(ring_fd >= 0 && !waiting){
+        reap();
+        enter();
+    }
+    while(free_buffers.empty() && !failed){
+        if(ring_fd >= 0 && free_writes.size() < writes.size()){
+            wait_completion(lk);
+        }
+        else{
+            // the buffers are all acquired by other threads
+            buffer_cv.wait(lk);
+        }
+    }
+    int buffer = 0;
+    // after a failure the output is not valid anyway, so buffers are reused without waiting
+    if(!free_buffers.empty()){
+        buffer = free_buffers.back();
+        free_buffers.pop_back();
+    }
+    buffer_writes[buffer]++;
+    return pool + buffer * stride + offset % ALIGNMENT;
+}
+
+/**
+ * @brief method writing the data of an acquired buffer, the buffer goes back to the pool once it is written
+ *
+ * The buffer must not be used after this call.
+ *
+ * @param data start of the data, inside the buffer returned by acquire
+ * @param size number of bytes to write
+ * @param offset position of the first byte in the file, must have the same alignment as data
+ */
+void AsyncWriter::submit(char *data, size_t size, uint64_t offset){
+    std::lock_guard lk(m);
+    int buffer = (data - pool) / stride;
+    // in direct mode the first and last partial pages are written through the page cache
+    size_t head = size;
+    size_t body = 0;
+    if(direct_fd >= 0){
+        head = std::min(size, (ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT);
+        body = (size - head) / ALIGNMENT * ALIGNMENT;
+    }
+    size_t tail = size - head - body;
+    std::pair<int, size_t> parts[3] = {{fd, head}, {direct_fd, body}, {fd, tail}};
+
+    for(auto &[part_fd, part_size] : parts){
+        if(part_size > 0 && !failed){
+            if(ring_fd >= 0){
+                start_write(buffer, part_fd, data, part_size, offset);
+            }
+            else{
+                failed = !write_all(part_fd, data, part_size, offset);
+            }
+        }
+        data += part_size;
+        offset += part_size;
+    }
+    if(ring_fd >= 0){
+        enter();
+    }
+    release(buffer);
+    // threads waiting for a buffer can now wait for the completion of these writes
+    buffer_cv.notify_all();
+}
+
+/**
+ * @brief method waiting for all the writes in flight
+ *
+ * @return true if all the writes were successful
+ * @return false otherwise
+ */
+bool AsyncWriter::finish(){
+    std::unique_lock lk(m);
+    if(ring_fd >= 0){
+        enter();
+        while(free_writes.size() < writes.size() && !failed){
+            wait_completion(lk);
+        }
+    }
+    return !failed;
+}
+
+/**
+ * @brief method assigning an entry to a write and adding it to the submission queue
+ *
+ * @param buffer index of the buffer containing the data
+ * @param fd descriptor to write to
+ * @param data bytes to write
+ * @param size number of bytes to write
+ * @param offset position of the first byte in the file
+ */
+void AsyncWriter::start_write(int buffer, int fd, const char *data, size_t size, uint64_t offset){
+    int write = free_writes.back();
+    free_writes.pop_back();
+    writes[write] = {buffer, fd, data, size, offset};
+    buffer_writes[buffer]++;
+    queue(write);
+}
+
+/**
+ * @brief method adding a write to the submission queue, also used to write what is left after a short write
+ *
+ * The queue has an entry for each write, so it is never full.
+ *
+ * @param write index of the write
+ */
+void AsyncWriter::queue(int write){
+    auto &w = writes[write];
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = w.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(w.data);
+    sqe->len = w.size;
+    sqe->off = w.offset;
+    sqe->buf_index = w.buffer;
+    sqe->user_data = write;
+    sq_array[index] = index;
+    // the kernel must see the entry before the new tail
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    to_submit++;
+}
+
+/**
+ * @brief method passing the queued entries to the kernel
+ *
+ */
+void AsyncWriter::enter(){
+    while(to_submit > 0){
+        int ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, 0, 0, nullptr, 0);
+        if(ret < 0 && errno == EINTR){
+            continue;
+        }
+        if(ret < 0){
+            // the queued writes will never complete
+            failed = true;
+            return;
+        }
+        to_submit -= ret;
+    }
+}
+
+/**
+ * @brief method waiting for at least one write to complete, must be called with writes in flight
+ *
+ * The lock is released while waiting in the kernel, so that other threads can keep submitting. A single thread
+ * waits in the kernel and processes the completions, the others wait for it to wake them.
+ *
+ * @param lk lock on m, held by the caller
+ */
+void AsyncWriter::wait_completion(std::unique_lock<std::mutex> &lk){
+    if(waiting){
+        buffer_cv.wait(lk);
+        return;
+    }
+    waiting = true;
+    enter();
+    lk.unlock();
+    int ret = syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    int error = errno;
+    lk.lock();
+    waiting = false;
+    if(ret < 0 && error != EINTR){
+        failed = true;
+    }
+    reap();
+    enter();
+    buffer_cv.notify_all();
+}
+
+/**
+ * @brief method processing the completed writes, buffers whose writes are all done go back to the pool
+ *
+ */
+void AsyncWriter::reap(){
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    for(; head != tail; head++){
+        io_uring_cqe *cqe = &cqes[head & *cq_mask];
+        int write = cqe->user_data;
+        auto &w = writes[write];
+        int res = cqe->res;
+        if(res == -EINTR || res == -EAGAIN){
+            queue(write);
+            continue;
+        }
+        if(res <= 0){
+            failed = true;
+        }
+        else if(res < w.size){
+            // the rest of a short write is written again
+            w.data += res;
+            w.size -= res;
+            w.offset += res;
+            queue(write);
+            continue;
+        }
+        free_writes.push_back(write);
+        release(w.buffer);
+    }
+    // the kernel can reuse the entries once the new head is visible
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief method dropping a reference to a buffer, which goes back to the pool when it has none
+ *
+ * @param buffer index of the buffer
+ */
+void AsyncWriter::release(int buffer){
+    if(--buffer_writes[buffer] == 0){
+        free_buffers.push_back(buffer);
+        buffer_cv.notify_one();
+    }
+}
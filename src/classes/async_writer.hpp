@@ -0,0 +1,168 @@
+/**
+ * @file async_writer.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class writing parts of an output file asynchronously with io_uring
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <linux/io_uring.h>
+
+#include "output_file.hpp"
+
+
+/**
+ * @brief class writing parts of an output file asynchronously through a pool of buffers
+ *
+ * A thread takes a buffer with acquire, fills it and gives it back with submit, which queues the write and returns
+ * immediately. Buffers go back to the pool when their write completes, acquire waits for a completion only if all
+ * the buffers are in use. Writes go through io_uring using raw system calls, with the buffers registered in the
+ * kernel when the memory lock limit allows it. If io_uring is not available writes are made in submit.
+ *
+ * In direct mode the parts of each write covering whole pages bypass the page cache, while the first and last
+ * partial pages go through the descriptor of the OutputFile. Buffers are placed so that their address has the same
+ * alignment as the offset they are written to, which is what direct writes require.
+ *
+ */
+class AsyncWriter{
+    private:
+        /**
+         * @brief type storing a write in flight
+         *
+         */
+        typedef struct{
+            int buffer;
+            int fd;
+            const char *data;
+            size_t size;
+            uint64_t offset;
+        } pending_write;
+
+        /**
+         * @brief buffered descriptor of the file, owned by the OutputFile
+         *
+         */
+        int fd;
+        /**
+         * @brief descriptor of the file opened with O_DIRECT, -1 if not in direct mode
+         *
+         */
+        int direct_fd = -1;
+        /**
+         * @brief descriptor of the ring, -1 if io_uring is not used
+         *
+         */
+        int ring_fd = -1;
+        /**
+         * @brief whether the buffers are registered in the kernel
+         *
+         */
+        bool registered = false;
+        /**
+         * @brief set when a write fails
+         *
+         */
+        bool failed = false;
+        /**
+         * @brief set while a thread waits for completions in the kernel, only that thread processes them
+         *
+         */
+        bool waiting = false;
+
+        // mappings of the rings shared with the kernel
+        void *sq_ring = nullptr;
+        void *cq_ring = nullptr;
+        size_t sq_ring_size = 0;
+        size_t cq_ring_size = 0;
+        io_uring_sqe *sqes = nullptr;
+        size_t sqes_size = 0;
+        unsigned *sq_tail;
+        unsigned *sq_mask;
+        unsigned *sq_array;
+        unsigned *cq_head;
+        unsigned *cq_tail;
+        unsigned *cq_mask;
+        io_uring_cqe *cqes;
+        /**
+         * @brief number of entries queued and not yet passed to the kernel
+         *
+         */
+        unsigned to_submit = 0;
+
+        /**
+         * @brief memory of all the buffers, each one starts at a multiple of ALIGNMENT
+         *
+         */
+        char *pool = nullptr;
+        /**
+         * @brief distance between the starts of two buffers
+         *
+         */
+        size_t stride;
+        /**
+         * @brief references to each buffer, one while it is acquired and one for each of its writes in flight
+         *
+         */
+        std::vector<int> buffer_writes;
+        /**
+         * @brief buffers which can be acquired
+         *
+         */
+        std::vector<int> free_buffers;
+        /**
+         * @brief writes in flight, indexed by the user data of their entries
+         *
+         */
+        std::vector<pending_write> writes;
+        /**
+         * @brief entries of writes not in use
+         *
+         */
+        std::vector<int> free_writes;
+        /**
+         * @brief lock protecting the pool and the rings
+         *
+         */
+        std::mutex m;
+        /**
+         * @brief used to wake threads waiting for a buffer or for the thread waiting in the kernel
+         *
+         */
+        std::condition_variable buffer_cv;
+
+        bool setup_ring(unsigned entries);
+        void close_ring();
+        void start_write(int buffer, int fd, const char *data, size_t size, uint64_t offset);
+        void queue(int write);
+        void enter();
+        void wait_completion(std::unique_lock<std::mutex> &lk);
+        void reap();
+        void release(int buffer);
+
+    public:
+        /**
+         * @brief alignment of buffers and writes in direct mode, the page size
+         *
+         */
+        static constexpr size_t ALIGNMENT = 4096;
+
+        AsyncWriter(OutputFile &output_file, const std::string &filename, int n_buffers, size_t buffer_size, bool direct = false);
+        ~AsyncWriter();
+        AsyncWriter(const AsyncWriter &) = delete;
+        AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+        bool isAsync();
+        bool isRegistered();
+        bool isDirect();
+        char *acquire(uint64_t offset);
+        void submit(char *data, size_t size, uint64_t offset);
+        bool finish();
+};
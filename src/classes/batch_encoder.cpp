@@ -0,0 +1,392 @@
+/**
+ * @file batch_encoder.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class encoding many files in the same process
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "batch_encoder.hpp"
+#include <memory>
+#include <filesystem>
+#include <algorithm>
+#include <sys/resource.h>
+
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "block_scheduler.hpp"
+#include "huffman_tree.hpp"
+#include "bit_writer.hpp"
+#include "histogram.hpp"
+#include "mapped_file.hpp"
+#include "input_file.hpp"
+#include "output_file.hpp"
+
+
+/**
+ * @brief type storing the state of a large file during its round
+ *
+ */
+struct large_file{
+    int file;
+    uint64_t size;
+    std::unique_ptr<MappedFile> mapping;
+    // character counts of each chunk, the last chunk counted completes the file
+    std::vector<std::vector<uint64_t>> chunk_counts;
+    std::atomic<int> chunks_left;
+    std::unique_ptr<FileHeader> header;
+    std::unique_ptr<BitWriter> writer;
+    std::vector<uint64_t> chunk_offsets;
+    std::unique_ptr<OutputFile> output;
+    std::atomic<bool> failed = false;
+};
+
+
+/**
+ * @brief Construct a new Batch Encoder:: Batch Encoder object
+ *
+ * @param inputs paths of the files to encode
+ * @param outputs paths of the encoded files, one for each input
+ * @param n_threads number of threads to use, must be positive
+ * @param max_length maximum length of the codes, 0 if not limited
+ * @param checksums whether the encoded files store a checksum of their header and of each chunk
+ */
+BatchEncoder::BatchEncoder(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs, int n_threads, int max_length,
+                            bool checksums){
+    this->inputs = inputs;
+    this->outputs = outputs;
+    this->n_threads = n_threads;
+    this->max_length = max_length;
+    this->checksums = checksums;
+}
+
+/**
+ * @brief getter method for the number of files to encode
+ *
+ * @return int
+ */
+int BatchEncoder::getNFiles(){return inputs.size();}
+/**
+ * @brief getter method for the number of tasks run in the last encoding
+ *
+ * @return int
+ */
+int BatchEncoder::getNTasks(){return n_tasks;}
+/**
+ * @brief getter method for the number of rounds of large files in the last encoding
+ *
+ * @return int
+ */
+int BatchEncoder::getNRounds(){return n_rounds;}
+/**
+ * @brief getter method for the number of characters of all the files
+ *
+ * @return uint64_t
+ */
+uint64_t BatchEncoder::getNChars(){return n_chars;}
+/**
+ * @brief method checking if a file was encoded in the last encoding
+ *
+ * @param file index of the file
+ * @return true if its output was written
+ * @return false otherwise
+ */
+bool BatchEncoder::isEncoded(int file){return encoded[file];}
+/**
+ * @brief getter method for the time spent opening and reading the files
+ *
+ * @return long
+ */
+long BatchEncoder::getReadTime(){return read_time;}
+/**
+ * @brief getter method for the time spent counting the characters and building the codes
+ *
+ * @return long
+ */
+long BatchEncoder::getFreqTime(){return freq_time;}
+/**
+ * @brief getter method for the time spent encoding
+ *
+ * @return long
+ */
+long BatchEncoder::getEncodeTime(){return encode_time;}
+/**
+ * @brief getter method for the time spent creating and writing the outputs
+ *
+ * @return long
+ */
+long BatchEncoder::getWriteTime(){return write_time;}
+/**
+ * @brief getter method for the cost of limiting the length of the codes of the tables built in the last encoding
+ *
+ * @return LengthLimitReport&
+ */
+LengthLimitReport &BatchEncoder::getLimitReport(){return limit_report;}
+
+/**
+ * @brief method reading, counting, encoding and writing a small file in a single chunk
+ *
+ * @param file index of the file
+ * @param size size of the file, at most a chunk
+ * @param buffer buffer reused by the thread to store the file
+ * @param output_buf buffer reused by the thread to store the encoded file
+ * @return true if the encoded file was written
+ * @return false otherwise
+ */
+bool BatchEncoder::encode_small(int file, uint64_t size, std::vector<unsigned char> &buffer, std::vector<char> &output_buf){
+    Timer timer;
+    timer.start("reading_input");
+    InputFile input(inputs[file]);
+    buffer.resize(size);
+    bool ok = input.is_open() && input.size() == size && input.read(0, size, buffer.data());
+    read_time += timer.stop();
+    if(!ok){
+        return false;
+    }
+
+    timer.start("freq_time");
+    std::vector<uint64_t> counts(256, 0);
+    count_bytes(buffer.data(), size, counts);
+    HuffmanTree ht(counts, max_length);
+    limit_report.add(ht, counts);
+    FileHeader header(FileHeader::CANONICAL_64, 1, counts, ht, FileHeader::DEFAULT_CHUNK_CHARS);
+    header.setChecksums(checksums);
+    BitWriter writer(header.getCodes());
+    freq_time += timer.stop();
+
+    // the header of the file and of its chunk are written before the encoding, so that the file is written with a single call
+    // files which would not shrink are stored raw
+    timer.start("encode");
+    auto header_buf = header.serialize();
+    size_t start = header_buf.size() + header.serializeChunk(0, 0).size();
+    uint64_t n_bits = writer.encoded_bits(counts);
+    bool raw = header.storeRaw(n_bits, size);
+    uint64_t chunk_size = header.storedSize(n_bits, size);
+    output_buf.resize(start + (raw ? size : BitWriter::buffer_size(n_bits)));
+    std::copy(header_buf.begin(), header_buf.end(), output_buf.begin());
+    if(raw){
+        std::copy(buffer.begin(), buffer.begin() + size, output_buf.begin() + start);
+    }
+    else{
+        writer.encode(buffer.data(), size, output_buf.data() + start);
+    }
+    auto chunk_header = header.serializeChunk(chunk_size, raw ? FileHeader::RAW_CHUNK : BitWriter::padding(n_bits), nullptr, 0,
+                                                output_buf.data() + start);
+    std::copy(chunk_header.begin(), chunk_header.end(), output_buf.begin() + header_buf.size());
+    encode_time += timer.stop();
+
+    timer.start("write");
+    OutputFile output(outputs[file]);
+    ok = output.is_open() && output.write(0, output_buf.data(), start + chunk_size);
+    write_time += timer.stop();
+    return ok;
+}
+
+/**
+ * @brief method encoding all the files
+ *
+ * Each round runs three phases on the pool: the large files of the round are mapped, then the tasks of small files
+ * and the chunks of the large files are processed, then the chunks of the large files are encoded and written.
+ * A file which cannot be read or written does not stop the others.
+ *
+ * @return true if all the files were encoded
+ * @return false otherwise, see isEncoded
+ */
+bool BatchEncoder::encode(){
+    read_time = 0;
+    freq_time = 0;
+    encode_time = 0;
+    write_time = 0;
+    n_tasks = 0;
+    n_chars = 0;
+    limit_report.reset();
+    int n_files = inputs.size();
+    encoded.assign(n_files, false);
+    const uint64_t chunk_chars = FileHeader::DEFAULT_CHUNK_CHARS;
+
+    // files fitting in a chunk are small, files whose size cannot be read are left not encoded
+    std::vector<uint64_t> sizes(n_files, 0);
+    std::vector<int> small_files;
+    std::vector<int> large_files;
+    for(int f=0; f<n_files; f++){
+        std::error_code ec;
+        sizes[f] = std::filesystem::file_size(inputs[f], ec);
+        if(ec){
+            continue;
+        }
+        n_chars += sizes[f];
+        if(sizes[f] <= chunk_chars){
+            small_files.push_back(f);
+        }
+        else{
+            large_files.push_back(f);
+        }
+    }
+
+    // consecutive small files are packed in tasks, as ranges of small_files
+    std::vector<std::pair<int, int>> packs;
+    uint64_t pack_chars = 0;
+    for(int i=0; i<small_files.size(); i++){
+        if(pack_chars == 0){
+            packs.push_back({i, i});
+        }
+        packs.back().second = i + 1;
+        pack_chars += sizes[small_files[i]] + FILE_COST;
+        if(pack_chars >= TASK_CHARS){
+            pack_chars = 0;
+        }
+    }
+
+    ThreadPool &pool = ThreadPool::shared(n_threads);
+    // each large file keeps two descriptors open, and each thread may hold the two of a small file
+    // a few more are left for the standard streams and the rest of the process
+    int round_files = MAX_OPEN_FILES;
+    rlimit file_limit;
+    if(getrlimit(RLIMIT_NOFILE, &file_limit) == 0 && file_limit.rlim_cur != RLIM_INFINITY){
+        long available = long(file_limit.rlim_cur) - 2 * pool.size() - 16;
+        round_files = std::clamp(available / 2, 1L, long(MAX_OPEN_FILES));
+    }
+    n_rounds = std::max(size_t(1), (large_files.size() + round_files - 1) / round_files);
+    for(int r=0; r<n_rounds; r++){
+        int first_large = r * round_files;
+        int last_large = std::min(int(large_files.size()), first_large + round_files);
+        int first_pack = packs.size() * r / n_rounds;
+        int n_packs = packs.size() * (r + 1) / n_rounds - first_pack;
+
+        std::vector<std::unique_ptr<large_file>> round;
+        std::vector<std::pair<int, int>> chunk_tasks;
+        for(int i=first_large; i<last_large; i++){
+            auto lf = std::make_unique<large_file>();
+            lf->file = large_files[i];
+            lf->size = sizes[lf->file];
+            int n_chunks = (lf->size + chunk_chars - 1) / chunk_chars;
+            lf->chunk_counts.resize(n_chunks);
+            lf->chunks_left = n_chunks;
+            for(int c=0; c<n_chunks; c++){
+                chunk_tasks.push_back({int(round.size()), c});
+            }
+            round.push_back(std::move(lf));
+        }
+
+        // the large files of the round are mapped in parallel, a file may have changed since its size was read
+        std::atomic<int> next_file = 0;
+        pool.run([&](int tid){
+            Timer timer;
+            for(int l = next_file++; l < round.size(); l = next_file++){
+                auto &lf = *round[l];
+                timer.start("reading_input");
+                lf.mapping = std::make_unique<MappedFile>(inputs[lf.file]);
+                lf.failed = !lf.mapping->is_open() || lf.mapping->size() != lf.size;
+                read_time += timer.stop();
+            }
+        });
+
+        // small files are encoded by their task, chunks of large files are counted
+        BlockScheduler count_scheduler(n_packs + chunk_tasks.size(), pool.size());
+        pool.run([&](int tid){
+            Timer timer;
+            std::vector<unsigned char> buffer;
+            std::vector<char> output_buf;
+            int t;
+            while(count_scheduler.next(tid, t)){
+                if(t < n_packs){
+                    auto [first, last] = packs[first_pack + t];
+                    for(int i=first; i<last; i++){
+                        int f = small_files[i];
+                        encoded[f] = encode_small(f, sizes[f], buffer, output_buf);
+                    }
+                    continue;
+                }
+
+                auto [l, c] = chunk_tasks[t - n_packs];
+                auto &lf = *round[l];
+                if(!lf.failed){
+                    timer.start("freq_time");
+                    auto chunk = lf.mapping->span(c * chunk_chars, std::min(chunk_chars, lf.size - c * chunk_chars));
+                    lf.chunk_counts[c].assign(256, 0);
+                    count_bytes(chunk.data, chunk.size, lf.chunk_counts[c]);
+                    freq_time += timer.stop();
+                }
+                if(--lf.chunks_left != 0 || lf.failed){
+                    continue;
+                }
+
+                // the last chunk counted builds the codes of the file and creates its output with its final size
+                timer.start("freq_time");
+                std::vector<uint64_t> counts(256, 0);
+                for(auto &chunk_counts : lf.chunk_counts){
+                    for(int i=0; i<256; i++){
+                        counts[i] += chunk_counts[i];
+                    }
+                }
+                HuffmanTree ht(counts, max_length);
+                limit_report.add(ht, counts);
+                int n_chunks = lf.chunk_counts.size();
+                lf.header = std::make_unique<FileHeader>(FileHeader::CANONICAL_64, n_chunks, counts, ht, chunk_chars);
+                lf.header->setChecksums(checksums);
+                lf.writer = std::make_unique<BitWriter>(lf.header->getCodes());
+                freq_time += timer.stop();
+
+                timer.start("write");
+                auto header_buf = lf.header->serialize();
+                size_t chunk_header_size = lf.header->serializeChunk(0, 0).size();
+                lf.chunk_offsets.resize(n_chunks + 1);
+                lf.chunk_offsets[0] = header_buf.size();
+                for(int i=0; i<n_chunks; i++){
+                    uint64_t chunk_size = std::min(chunk_chars, lf.size - i * chunk_chars);
+                    lf.chunk_offsets[i+1] = lf.chunk_offsets[i] + chunk_header_size
+                                            + lf.header->storedSize(lf.writer->encoded_bits(lf.chunk_counts[i]), chunk_size);
+                }
+                lf.output = std::make_unique<OutputFile>(outputs[lf.file]);
+                lf.failed = !lf.output->is_open() || !lf.output->allocate(lf.chunk_offsets[n_chunks])
+                            || !lf.output->write(0, header_buf.data(), header_buf.size());
+                write_time += timer.stop();
+            }
+        });
+
+        // chunks of large files are encoded and written to their position
+        BlockScheduler encode_scheduler(chunk_tasks.size(), pool.size());
+        pool.run([&](int tid){
+            Timer timer;
+            std::vector<char> output_buf;
+            int t;
+            while(encode_scheduler.next(tid, t)){
+                auto [l, c] = chunk_tasks[t];
+                auto &lf = *round[l];
+                if(lf.failed){
+                    continue;
+                }
+                timer.start("encode");
+                auto chunk = lf.mapping->span(c * chunk_chars, std::min(chunk_chars, lf.size - c * chunk_chars));
+                size_t chunk_header_size = lf.header->serializeChunk(0, 0).size();
+                uint64_t n_bits = lf.writer->encoded_bits(lf.chunk_counts[c]);
+                bool raw = lf.header->storeRaw(n_bits, chunk.size);
+                uint64_t chunk_size = lf.header->storedSize(n_bits, chunk.size);
+                output_buf.resize(chunk_header_size + (raw ? chunk.size : BitWriter::buffer_size(n_bits)));
+                if(raw){
+                    std::copy(chunk.data, chunk.data + chunk.size, output_buf.begin() + chunk_header_size);
+                }
+                else{
+                    lf.writer->encode(chunk.data, chunk.size, output_buf.data() + chunk_header_size);
+                }
+                auto chunk_header = lf.header->serializeChunk(chunk_size, raw ? FileHeader::RAW_CHUNK : BitWriter::padding(n_bits),
+                                                                nullptr, 0, output_buf.data() + chunk_header_size);
+                std::copy(chunk_header.begin(), chunk_header.end(), output_buf.begin());
+                encode_time += timer.stop();
+
+                timer.start("write");
+                if(!lf.output->write(lf.chunk_offsets[c], output_buf.data(), chunk_header_size + chunk_size)){
+                    lf.failed = true;
+                }
+                write_time += timer.stop();
+            }
+        });
+
+        for(auto &lf : round){
+            encoded[lf->file] = !lf->failed;
+        }
+        n_tasks += n_packs + 2 * chunk_tasks.size();
+    }
+
+    return std::all_of(encoded.begin(), encoded.end(), [](char e){return e;});
+}
@@ -0,0 +1,142 @@
+/**
+ * @file batch_encoder.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class encoding many files in the same process
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+#include "file_header.hpp"
+#include "huffman_tree.hpp"
+
+
+/**
+ * @brief class encoding a list of files on the shared thread pool, each one to its own output file
+ *
+ * Each output is the same file the parallel encoder writes for its input, with chunks of
+ * FileHeader::DEFAULT_CHUNK_CHARS characters and the codes of the whole file.
+ * Files fitting in a single chunk are small: they are packed in tasks of about TASK_CHARS characters, and a task
+ * reads, counts, encodes and writes each of its files without synchronizing with other tasks.
+ * Larger files are mapped in memory and split in chunks, which are counted in parallel. The thread counting the
+ * last chunk of a file builds its codes and creates its output, then the chunks are encoded in parallel.
+ * Large files are processed in rounds of at most MAX_OPEN_FILES files, so that the number of open files is bounded,
+ * and the small tasks are spread between the rounds so that the threads always have work.
+ *
+ */
+class BatchEncoder{
+    private:
+        /**
+         * @brief paths of the files to encode
+         *
+         */
+        std::vector<std::string> inputs;
+        /**
+         * @brief paths of the encoded files, one for each input
+         *
+         */
+        std::vector<std::string> outputs;
+        /**
+         * @brief number of threads to use
+         *
+         */
+        int n_threads;
+        /**
+         * @brief maximum length of the codes, 0 if not limited
+         *
+         */
+        int max_length;
+        /**
+         * @brief whether the encoded files store checksums
+         *
+         */
+        bool checksums;
+        /**
+         * @brief whether each file was encoded in the last encoding, as chars so that threads can set them concurrently
+         *
+         */
+        std::vector<char> encoded;
+        /**
+         * @brief number of tasks run in the last encoding, summed between the phases
+         *
+         */
+        int n_tasks = 0;
+        /**
+         * @brief number of rounds of large files in the last encoding
+         *
+         */
+        int n_rounds = 0;
+        /**
+         * @brief number of characters of all the files
+         *
+         */
+        uint64_t n_chars = 0;
+        /**
+         * @brief time spent opening and reading the files, summed between threads
+         *
+         */
+        std::atomic<long> read_time = 0;
+        /**
+         * @brief time spent counting and building the codes, summed between threads
+         *
+         */
+        std::atomic<long> freq_time = 0;
+        /**
+         * @brief time spent encoding, summed between threads
+         *
+         */
+        std::atomic<long> encode_time = 0;
+        /**
+         * @brief time spent creating and writing the outputs, summed between threads
+         *
+         */
+        std::atomic<long> write_time = 0;
+        /**
+         * @brief cost of limiting the length of the codes of the tables built in the last encoding
+         *
+         */
+        LengthLimitReport limit_report;
+
+        bool encode_small(int file, uint64_t size, std::vector<unsigned char> &buffer, std::vector<char> &output_buf);
+
+    public:
+        /**
+         * @brief number of characters small files are packed up to in a task, the same as a chunk of a large file
+         *
+         */
+        static const uint64_t TASK_CHARS = FileHeader::DEFAULT_CHUNK_CHARS;
+        /**
+         * @brief cost of opening and creating a file, counted as this many characters when packing small files,
+         * so that a task does not hold too many empty files
+         *
+         */
+        static const uint64_t FILE_COST = 4096;
+        /**
+         * @brief maximum number of large files in a round, each keeps its input and its output open.
+         * Rounds are smaller if the limit on open files of the process is lower
+         *
+         */
+        static const int MAX_OPEN_FILES = 256;
+
+        BatchEncoder(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs, int n_threads, int max_length = 0,
+                        bool checksums = false);
+
+        int getNFiles();
+        int getNTasks();
+        int getNRounds();
+        uint64_t getNChars();
+        bool isEncoded(int file);
+        long getReadTime();
+        long getFreqTime();
+        long getEncodeTime();
+        long getWriteTime();
+        LengthLimitReport &getLimitReport();
+
+        bool encode();
+};
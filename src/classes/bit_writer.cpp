@@ -0,0 +1,156 @@
+/**
+ * @file bit_writer.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class packing Huffman codes into a bitstream
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "bit_writer.hpp"
+#include <cstring>
+#include <algorithm>
+
+
+/**
+ * @brief helper function storing a word to memory with the most significant byte first
+ *
+ * @param output pointer to the memory to write to, does not need to be aligned
+ * @param word word to store
+ */
+static inline void store_word(char *output, uint64_t word){
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    std::memcpy(output, &word, sizeof(word));
+}
+
+/**
+ * @brief Construct a new Bit Writer:: Bit Writer object
+ *
+ * @param codes table of encodings as returned by HuffmanTree::getCodes
+ */
+BitWriter::BitWriter(const std::vector<std::pair<int, int>> &codes){
+    for(int i=0; i<codes.size() && i<256; i++){
+        // code is stored as an int, reinterpret it as unsigned to avoid sign extension
+        uint64_t code = uint32_t(codes[i].second);
+        code_table[i] = (code << 8) | uint64_t(codes[i].first);
+    }
+}
+
+/**
+ * @brief method computing the exact size of the encoding from the frequencies of the characters
+ *
+ * @param char_counts vector containing the frequencies of the characters to encode
+ * @return uint64_t number of bits of the encoding
+ */
+uint64_t BitWriter::encoded_bits(const std::vector<uint64_t> &char_counts) const{
+    uint64_t n_bits = 0;
+    for(int i=0; i<char_counts.size() && i<256; i++){
+        n_bits += char_counts[i] * (code_table[i] & 0xFF);
+    }
+    return n_bits;
+}
+
+/**
+ * @brief method to encode a buffer of characters
+ *
+ * The output buffer must be at least buffer_size(n + skip) bytes long, where n is the number of bits of the encoding
+ * (see encoded_bits). Whole words are written to it, the padding bits of the last byte are set to 0.
+ * Skipping bits allows to encode a part of a bitstream starting in the middle of a byte: the skipped bits
+ * are set to 0, so the first byte can be merged with the last one of the previous part with a bitwise or.
+ *
+ * @param input pointer to the characters to encode
+ * @param size number of characters to encode
+ * @param output pointer to the buffer to write the encoding to
+ * @param skip number of bits at the start of the output to leave empty, less than 8
+ * @param exact whether to write only the bytes of the encoding, so that the output needs byte_size(n + skip) bytes.
+ * Used to encode in place, when the bytes that follow belong to someone else
+ * @return uint64_t number of bits written, padding and skipped bits excluded
+ */
+uint64_t BitWriter::encode(const unsigned char *input, size_t size, char *output, int skip, bool exact) const{
+    const uint64_t *table = code_table.data();
+    char *output_start = output;
+    // bits waiting to be written, aligned to the right of the accumulator
+    uint64_t acc = 0;
+    // number of relevant bits in the accumulator, always less than 64
+    int acc_len = skip;
+
+    for(size_t i=0; i<size; i++){
+        uint64_t entry = table[input[i]];
+        int len = entry & 0xFF;
+        uint64_t code = entry >> 8;
+
+        if(acc_len + len < 64){
+            acc = (acc << len) | code;
+            acc_len += len;
+        }
+        else{
+            // fill the accumulator with the highest bits of the code and flush it,
+            // the bits left over are kept in the accumulator
+            int spill = acc_len + len - 64;
+            acc = (acc << (len - spill)) | (code >> spill);
+            store_word(output, acc);
+            output += sizeof(acc);
+            // bits above the spilled ones are discarded by the shifts that follow
+            acc = code;
+            acc_len = spill;
+        }
+    }
+
+    // flush the remaining bits, aligned to the left so that padding is made of zeros
+    if(acc_len != 0 && exact){
+        char last[sizeof(acc)];
+        store_word(last, acc << (64 - acc_len));
+        std::memcpy(output, last, (acc_len + 7) / 8);
+    }
+    else if(acc_len != 0){
+        store_word(output, acc << (64 - acc_len));
+    }
+
+    return uint64_t(output - output_start) * 8 + acc_len - skip;
+}
+
+/**
+ * @brief method returning the length of the longest code, used to bound the size of an encoding
+ * when the character counts are not known
+ *
+ * @return int length of the longest code in bits
+ */
+int BitWriter::max_length() const{
+    int longest = 0;
+    for(auto &entry : code_table){
+        longest = std::max(longest, int(entry & 0xFF));
+    }
+    return longest;
+}
+
+/**
+ * @brief method computing the size of the buffer needed by encode
+ *
+ * @param n_bits number of bits of the encoding
+ * @return size_t number of bytes to allocate, rounded up to whole words
+ */
+size_t BitWriter::buffer_size(uint64_t n_bits){return (n_bits + 63) / 64 * sizeof(uint64_t);}
+
+/**
+ * @brief method computing the number of bytes of the encoding, padding included
+ *
+ * @param n_bits number of bits of the encoding
+ * @return size_t number of bytes to write to file
+ */
+size_t BitWriter::byte_size(uint64_t n_bits){return (n_bits + 7) / 8;}
+
+/**
+ * @brief method computing the number of padding bits at the end of the encoding
+ *
+ * An empty encoding is considered as a single byte of padding, consistently with the original bit by bit encoder.
+ *
+ * @param n_bits number of bits of the encoding
+ * @return char number of padding bits
+ */
+char BitWriter::padding(uint64_t n_bits){
+    if(n_bits == 0){
+        return 8;
+    }
+    return 8 - ((n_bits - 1) % 8 + 1);
+}
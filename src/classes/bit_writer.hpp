@@ -0,0 +1,45 @@
+/**
+ * @file bit_writer.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class packing Huffman codes into a bitstream
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ * @brief class writing the encoding of a buffer of characters to memory
+ *
+ * Codes are accumulated in a 64 bit word, most significant bit first, and the word is written to the
+ * output buffer only once full. The bytes produced are the same obtained by packing the codes one bit
+ * at a time, so the output format is unchanged.
+ * The object only stores the table of encodings and can be shared between threads.
+ *
+ */
+class BitWriter{
+    private:
+        /**
+         * @brief table of encodings, indexed by character
+         *
+         * Each entry stores the code in the upper 56 bits and its length in the lowest 8 bits,
+         * so that a single lookup is needed for each character.
+         *
+         */
+        std::vector<uint64_t> code_table = std::vector<uint64_t>(256, 0);
+
+    public:
+        BitWriter(const std::vector<std::pair<int, int>> &codes);
+        uint64_t encoded_bits(const std::vector<uint64_t> &char_counts) const;
+        uint64_t encode(const unsigned char *input, size_t size, char *output, int skip = 0, bool exact = false) const;
+        int max_length() const;
+
+        static size_t buffer_size(uint64_t n_bits);
+        static size_t byte_size(uint64_t n_bits);
+        static char padding(uint64_t n_bits);
+};
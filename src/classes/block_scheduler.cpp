@@ -0,0 +1,86 @@
+/**
+ * @file block_scheduler.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class assigning blocks of a file to worker threads with work stealing
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "block_scheduler.hpp"
+
+
+/**
+ * @brief Construct a new Block Scheduler:: Block Scheduler object
+ *
+ * Blocks are split evenly between the workers, the first workers get one more block if they are not divisible.
+ *
+ * @param n_blocks number of blocks to assign
+ * @param n_workers number of workers, must be positive
+ */
+BlockScheduler::BlockScheduler(int n_blocks, int n_workers){
+    int first = 0;
+    for(int i=0; i<n_workers; i++){
+        auto range = std::make_unique<block_range>();
+        range->first = first;
+        range->last = first + n_blocks / n_workers + (i < n_blocks % n_workers);
+        first = range->last;
+        ranges.push_back(std::move(range));
+    }
+}
+
+/**
+ * @brief method returning the next block a worker has to process
+ *
+ * @param worker index of the worker
+ * @param block where to store the index of the block
+ * @return true if a block was assigned
+ * @return false if all the blocks were assigned
+ */
+bool BlockScheduler::next(int worker, int &block){
+    auto &own = *ranges[worker];
+    {
+        std::lock_guard lk(own.m);
+        if(own.first < own.last){
+            block = own.first++;
+            return true;
+        }
+    }
+    return steal(worker, block);
+}
+
+/**
+ * @brief method stealing blocks from the other workers, starting from the following one
+ *
+ * The stolen blocks become the range of the thief, apart from the first one which is returned.
+ * Locks are never held together, so workers cannot deadlock. A worker whose range is empty may still
+ * be working on blocks it just stole, but those are not lost since it processes them itself.
+ *
+ * @param worker index of the thief
+ * @param block where to store the index of the first stolen block
+ * @return true if some blocks were stolen
+ * @return false if all the ranges are empty
+ */
+bool BlockScheduler::steal(int worker, int &block){
+    int n_workers = ranges.size();
+    for(int i=1; i<n_workers; i++){
+        auto &victim = *ranges[(worker + i) % n_workers];
+        int first, last;
+        {
+            std::lock_guard lk(victim.m);
+            if(victim.first >= victim.last){
+                continue;
+            }
+            // the victim keeps the blocks it is about to read
+            last = victim.last;
+            first = victim.first + (victim.last - victim.first) / 2;
+            victim.last = first;
+        }
+        auto &own = *ranges[worker];
+        std::lock_guard lk(own.m);
+        own.first = first + 1;
+        own.last = last;
+        block = first;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file block_scheduler.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class assigning blocks of a file to worker threads with work stealing
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+
+/**
+ * @brief class assigning the indices of the blocks of a file to a fixed number of workers
+ *
+ * Each worker starts with a contiguous range of blocks and takes them from the front, so that it reads the file
+ * sequentially. A worker which runs out of blocks steals the second half of the remaining blocks of another
+ * worker, so that a slow worker does not delay the whole phase.
+ * Ranges are only touched by their owner and by thieves, so the lock of a range is rarely contended.
+ *
+ */
+class BlockScheduler{
+    private:
+        /**
+         * @brief range of blocks not yet taken by a worker, padded to avoid false sharing between workers
+         *
+         */
+        struct alignas(64) block_range{
+            std::mutex m;
+            int first = 0;
+            int last = 0;
+        };
+        /**
+         * @brief ranges of blocks of each worker
+         *
+         */
+        std::vector<std::unique_ptr<block_range>> ranges;
+
+        bool steal(int worker, int &block);
+
+    public:
+        BlockScheduler(int n_blocks, int n_workers);
+
+        bool next(int worker, int &block);
+};
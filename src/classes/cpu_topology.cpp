@@ -0,0 +1,187 @@
+/**
+ * @file cpu_topology.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class describing the CPUs and NUMA nodes the process can run on
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "cpu_topology.hpp"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <set>
+#include <cstdlib>
+#include <sched.h>
+#include <pthread.h>
+
+
+/**
+ * @brief Construct a new Cpu Topology:: Cpu Topology object, reading the topology of the machine
+ *
+ */
+CpuTopology::CpuTopology(){
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0){
+        CPU_SET(0, &allowed);
+    }
+    cpu_nodes.assign(CPU_SETSIZE, 0);
+
+    // nodes are numbered from 0, but their numbers may not be contiguous
+    int max_node = 0;
+    std::ifstream online_file("/sys/devices/system/node/online");
+    std::string online;
+    std::vector<int> nodes;
+    if(!online_file || !std::getline(online_file, online) || !parseCpuList(online, nodes)){
+        nodes.clear();
+    }
+    for(auto &node : nodes){
+        std::ifstream node_file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        std::vector<int> node_cpus;
+        if(!node_file || !std::getline(node_file, list) || !parseCpuList(list, node_cpus)){
+            continue;
+        }
+        for(auto &c : node_cpus){
+            if(c < CPU_SETSIZE){
+                cpu_nodes[c] = node;
+            }
+        }
+        max_node = node;
+    }
+
+    std::set<int> used_nodes;
+    for(int c=0; c<CPU_SETSIZE; c++){
+        if(CPU_ISSET(c, &allowed)){
+            cpus.push_back(c);
+            used_nodes.insert(cpu_nodes[c]);
+        }
+    }
+    std::stable_sort(cpus.begin(), cpus.end(), [this](int a, int b){return cpu_nodes[a] < cpu_nodes[b];});
+    n_nodes = std::max(max_node + 1, int(used_nodes.size()));
+}
+
+/**
+ * @brief method returning the node of a CPU
+ *
+ * @param cpu index of the CPU
+ * @return int
+ */
+int CpuTopology::getNode(int cpu){
+    if(cpu < 0 || cpu >= cpu_nodes.size()){
+        return 0;
+    }
+    return cpu_nodes[cpu];
+}
+/**
+ * @brief getter method for the number of nodes, including the ones the process cannot run on
+ *
+ * @return int
+ */
+int CpuTopology::getNNodes(){return n_nodes;}
+
+/**
+ * @brief method choosing the CPU of each worker thread
+ *
+ * The following policies are supported:
+ * - none: workers are not pinned, worker_cpus is left empty
+ * - compact: workers fill the CPUs of a node before moving to the next one, so they share caches and memory
+ * - scatter: workers are spread round robin between the nodes, so they use the memory bandwidth of all of them
+ * - a list of CPUs such as 0,2,4-7: worker i runs on the i-th CPU of the list
+ * Workers share CPUs if there are more workers than CPUs.
+ *
+ * @param policy placement policy
+ * @param n_threads number of workers
+ * @param worker_cpus where to store the CPU of each worker
+ * @return true if the policy is valid and all the CPUs can be used by the process
+ * @return false otherwise
+ */
+bool CpuTopology::placement(const std::string &policy, int n_threads, std::vector<int> &worker_cpus){
+    worker_cpus.clear();
+    if(policy == "none"){
+        return true;
+    }
+    if(policy == "compact"){
+        for(int i=0; i<n_threads; i++){
+            worker_cpus.push_back(cpus[i % cpus.size()]);
+        }
+        return true;
+    }
+    if(policy == "scatter"){
+        std::vector<std::vector<int>> node_cpus(n_nodes);
+        for(auto &c : cpus){
+            node_cpus[cpu_nodes[c]].push_back(c);
+        }
+        // nodes without usable CPUs are skipped
+        std::erase_if(node_cpus, [](auto &v){return v.empty();});
+        for(int i=0; i<n_threads; i++){
+            auto &node = node_cpus[i % node_cpus.size()];
+            worker_cpus.push_back(node[(i / node_cpus.size()) % node.size()]);
+        }
+        return true;
+    }
+
+    std::vector<int> list;
+    if(!parseCpuList(policy, list) || list.empty()){
+        return false;
+    }
+    for(auto &c : list){
+        if(std::find(cpus.begin(), cpus.end(), c) == cpus.end()){
+            return false;
+        }
+    }
+    for(int i=0; i<n_threads; i++){
+        worker_cpus.push_back(list[i % list.size()]);
+    }
+    return true;
+}
+
+/**
+ * @brief method parsing a list of CPUs in the format used by the kernel, such as 0,2,4-7
+ *
+ * @param list string to parse
+ * @param cpus where to store the CPUs, in the order of the list
+ * @return true if the list is valid
+ * @return false otherwise
+ */
+bool CpuTopology::parseCpuList(const std::string &list, std::vector<int> &cpus){
+    cpus.clear();
+    std::stringstream ss(list);
+    std::string range;
+    while(std::getline(ss, range, ',')){
+        if(range.empty() || range.find_first_not_of("0123456789-\n") != std::string::npos){
+            return false;
+        }
+        size_t dash = range.find('-');
+        int first = std::atoi(range.substr(0, dash).c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.substr(dash + 1).c_str());
+        if(last < first || last >= CPU_SETSIZE){
+            return false;
+        }
+        for(int c=first; c<=last; c++){
+            cpus.push_back(c);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief method pinning the calling thread to a CPU
+ *
+ * Used by threads which are not created by a ThreadPool, pinning is only a hint for performance so failures
+ * can be ignored.
+ *
+ * @param cpu index of the CPU
+ * @return true if the thread was pinned
+ * @return false otherwise
+ */
+bool CpuTopology::pin(int cpu){
+    if(cpu < 0 || cpu >= CPU_SETSIZE){
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
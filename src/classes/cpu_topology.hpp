@@ -0,0 +1,50 @@
+/**
+ * @file cpu_topology.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class describing the CPUs and NUMA nodes the process can run on
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <string>
+
+
+/**
+ * @brief class reading which CPUs the process can run on and which NUMA node each of them belongs to
+ *
+ * Nodes are read from /sys/devices/system/node, if it is missing all the CPUs are considered part of node 0.
+ * The class is used to choose the CPU of each worker thread, memory is then allocated on the right node
+ * by letting each worker be the first to touch the memory it uses.
+ *
+ */
+class CpuTopology{
+    private:
+        /**
+         * @brief CPUs the process can run on, ordered by node and then by index
+         *
+         */
+        std::vector<int> cpus;
+        /**
+         * @brief node of each CPU, indexed by CPU
+         *
+         */
+        std::vector<int> cpu_nodes;
+        /**
+         * @brief number of nodes with at least one CPU the process can run on
+         *
+         */
+        int n_nodes = 1;
+
+    public:
+        CpuTopology();
+
+        int getNode(int cpu);
+        int getNNodes();
+        bool placement(const std::string &policy, int n_threads, std::vector<int> &worker_cpus);
+
+        static bool parseCpuList(const std::string &list, std::vector<int> &cpus);
+        static bool pin(int cpu);
+};
@@ -0,0 +1,149 @@
+/**
+ * @file crc32c.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the functions computing CRC32C checksums
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "crc32c.hpp"
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+
+/**
+ * @brief reversed polynomial of CRC32C (Castagnoli)
+ *
+ */
+static const uint32_t POLYNOMIAL = 0x82F63B78;
+
+/**
+ * @brief type storing the tables of the software implementation, table j gives the contribution of a byte
+ * followed by j other bytes
+ *
+ */
+typedef struct{
+    uint32_t entries[8][256];
+} crc_tables;
+
+/**
+ * @brief helper function building the tables of the software implementation
+ *
+ * @return crc_tables
+ */
+static crc_tables build_tables(){
+    crc_tables tables;
+    for(uint32_t i=0; i<256; i++){
+        uint32_t crc = i;
+        for(int b=0; b<8; b++){
+            crc = (crc >> 1) ^ (POLYNOMIAL & (0 - (crc & 1)));
+        }
+        tables.entries[0][i] = crc;
+    }
+    for(uint32_t i=0; i<256; i++){
+        for(int j=1; j<8; j++){
+            uint32_t prev = tables.entries[j-1][i];
+            tables.entries[j][i] = (prev >> 8) ^ tables.entries[0][prev & 0xFF];
+        }
+    }
+    return tables;
+}
+
+/**
+ * @brief helper function updating a checksum with the software implementation, 8 bytes at a time
+ *
+ * @param crc checksum of the previous bytes, not inverted
+ * @param data pointer to the bytes
+ * @param size number of bytes
+ * @return uint32_t updated checksum, not inverted
+ */
+static uint32_t crc32c_software(uint32_t crc, const unsigned char *data, size_t size){
+    static const crc_tables tables = build_tables();
+    const auto &t = tables.entries;
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        word ^= crc;
+        crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^ t[5][(word >> 16) & 0xFF] ^ t[4][(word >> 24) & 0xFF]
+            ^ t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF] ^ t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+    }
+    for(; i < size; i++){
+        crc = (crc >> 8) ^ t[0][(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief helper function updating a checksum with the crc32 instruction of SSE4.2, 8 bytes at a time
+ *
+ * @param crc checksum of the previous bytes, not inverted
+ * @param data pointer to the bytes
+ * @param size number of bytes
+ * @return uint32_t updated checksum, not inverted
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *data, size_t size){
+    uint64_t crc64 = crc;
+    size_t i = 0;
+    for(; i + 32 <= size; i += 32){
+        uint64_t words[4];
+        std::memcpy(words, data + i, sizeof(words));
+        crc64 = _mm_crc32_u64(crc64, words[0]);
+        crc64 = _mm_crc32_u64(crc64, words[1]);
+        crc64 = _mm_crc32_u64(crc64, words[2]);
+        crc64 = _mm_crc32_u64(crc64, words[3]);
+    }
+    for(; i + 8 <= size; i += 8){
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = crc64;
+    for(; i < size; i++){
+        crc = _mm_crc32_u8(crc, data[i]);
+    }
+    return crc;
+}
+#endif
+
+/**
+ * @brief function checking if checksums are computed with the crc32 instruction of SSE4.2
+ *
+ * @return true if the processor supports it
+ * @return false if the tables are used
+ */
+bool crc32c_hardware(){
+#if defined(__x86_64__)
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief function computing the CRC32C checksum of a buffer, or extending the checksum of the bytes preceding it
+ *
+ * @param data pointer to the bytes, can be nullptr if size is 0
+ * @param size number of bytes
+ * @param crc checksum of the preceding bytes, 0 to start a new checksum
+ * @return uint32_t checksum of the preceding bytes followed by the buffer
+ */
+uint32_t crc32c(const void *data, size_t size, uint32_t crc){
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    crc = ~crc;
+#if defined(__x86_64__)
+    if(crc32c_hardware()){
+        return ~crc32c_sse42(crc, bytes, size);
+    }
+#endif
+    return ~crc32c_software(crc, bytes, size);
+}
@@ -0,0 +1,16 @@
+/**
+ * @file crc32c.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the functions computing CRC32C checksums
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+bool crc32c_hardware();
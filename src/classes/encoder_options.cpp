@@ -0,0 +1,355 @@
+/**
+ * @file encoder_options.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class parsing and validating the options of the encoders
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "encoder_options.hpp"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <climits>
+#include <unistd.h>
+
+#include "huffman_tree.hpp"
+#include "cpu_topology.hpp"
+
+using std::cout, std::endl, std::string, std::vector;
+
+
+/**
+ * @brief constructor of the class, no option is read until parse is called
+ *
+ * @param accepted getopt string of the options accepted by the encoder, a subset of ALL_OPTIONS
+ */
+EncoderOptions::EncoderOptions(const string &accepted){
+    this->accepted = accepted;
+}
+
+/**
+ * @brief method telling whether the encoder accepts an option
+ *
+ * @param opt letter of the option
+ * @return true if the option is in the getopt string of the encoder
+ */
+bool EncoderOptions::accepts(char opt) const{
+    return opt != ':' && accepted.find(opt) != string::npos;
+}
+
+/**
+ * @brief method printing the options accepted by the encoder
+ *
+ */
+void EncoderOptions::print_help() const{
+    // a batch is given with more than one -i option or with a list of files
+    string batch_input = accepts('I') ? " Can be given more than once to encode a batch of files." : "";
+    string batch_output = accepts('I') ? " For a batch, directory where each file is saved with the extension .dat." : "";
+    const vector<std::pair<char, string>> lines = {
+        {'i', "-i path: path to the file to be encoded, - for the standard input, required." + batch_input},
+        {'I', "-I path: path to a file listing the files to encode as a batch, one for each line."},
+        {'o', "-o path: path where the encoded file has to be saved, - for the standard output, required." + batch_output},
+        {'t', "-t number: number of threads to use, default 4."},
+        {'A', "-A policy: placement of the threads, compact, scatter, none or a list of CPUs such as 0,2,4-7, default none."},
+        {'v', "-v: set verbose."},
+        {'m', "-m bits: maximum length of the codes, between 1 and 32, default no limit."},
+        {'L', "-L: write the legacy header storing the character frequencies instead of the code lengths."},
+        {'c', "-c: write a single contiguous bitstream, the same written by the sequential version for any number of threads."},
+        {'p', "-p: read the file with positional reads from each thread instead of mapping it in memory."},
+        {'u', "-u: write the file asynchronously with io_uring, threads encode into buffers of the writer."},
+        {'D', "-D: write whole pages bypassing the page cache, only with -u."},
+        {'M', "-M: map the output file in memory and encode directly into it. Cannot be used with -b, -c or -u."},
+        {'s', "-s size: build the codes from a sample of size bytes of the file instead of counting all of it, only with -b."},
+        {'b', "-b size: encode the file in blocks of size bytes, reading it while encoding so that memory usage does not depend on its size."},
+        {'a', "-a: build the codes of each block from its own frequencies, only with -b."},
+        {'F', "-F msecs: when reading or writing a stream, maximum time a character waits for its block to be written, 0 for no limit, default 100."},
+        {'P', "-P path: when reading or writing a stream, use the codes built from the file at path for all the blocks they can encode."},
+        {'k', "-k: store a CRC32C checksum of the header and of each chunk, checked by hc_decode. Cannot be used with -L or -c."},
+        {'l', "-l dir: enable logging to file, output is written to directory dir."},
+        {'d', "-d: debug mode, only works if logging is enabled."}
+    };
+    cout << "The program accepts the following arguments:" << endl;
+    for(auto &[opt, line] : lines){
+        if(accepts(opt)){
+            cout << "\t " << line << endl;
+        }
+    }
+}
+
+/**
+ * @brief method reading the options from the command line and checking that they can be used together
+ *
+ * Options the encoder does not accept are rejected as unknown. Prints a message and the help if they cannot.
+ *
+ * @param argc number of arguments
+ * @param argv arguments, including the name of the program
+ * @param exit_code set to the value the program exits with if the options are not valid, 1 if the help was
+ * asked and 0 otherwise
+ * @return true if the input can be encoded with the options
+ * @return false if the program has to exit with exit_code
+ */
+bool EncoderOptions::parse(int argc, char *argv[], int &exit_code){
+    // list of the files of a batch, one for each line
+    string filelist = "";
+
+    // parse command line arguments
+    int opt;
+
+    while ((opt = getopt(argc, argv, accepted.c_str())) != -1) {
+        switch (opt) {
+        case 'h':
+            print_help();
+            exit_code = 1;
+            return false;
+        case 'i':
+            filename = optarg;
+            batch_filenames.push_back(optarg);
+            break;
+        case 'I':
+            filelist = optarg;
+            break;
+        case 'o':
+            output_filename = optarg;
+            break;
+        case 't':
+            n_threads = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'l':
+            log_folder = optarg;
+            break;
+        case 'L':
+            header_version = FileHeader::LEGACY;
+            break;
+        case 'm':
+            max_code_length = atoi(optarg);
+            break;
+        case 's':
+            sample_size = strtoull(optarg, nullptr, 10);
+            if(sample_size == 0){
+                cout << "Sample size must be positive." << endl;
+                print_help();
+                exit_code = 0;
+                return false;
+            }
+            break;
+        case 'b':
+            block_size = strtoull(optarg, nullptr, 10);
+            if(block_size == 0){
+                cout << "Block size must be positive." << endl;
+                print_help();
+                exit_code = 0;
+                return false;
+            }
+            break;
+        case 'd':
+            debug = true;
+            break;
+        case 'p':
+            positional = true;
+            break;
+        case 'c':
+            contiguous = true;
+            break;
+        case 'a':
+            adaptive = true;
+            break;
+        case 'A':
+            affinity = optarg;
+            break;
+        case 'u':
+            async = true;
+            break;
+        case 'D':
+            direct = true;
+            break;
+        case 'M':
+            mapped = true;
+            break;
+        case 'F':
+            latency = atol(optarg);
+            if(latency < 0){
+                cout << "Latency must not be negative." << endl;
+                print_help();
+                exit_code = 0;
+                return false;
+            }
+            break;
+        case 'P':
+            preload_filename = optarg;
+            break;
+        case 'k':
+            checksums = true;
+            break;
+        default:
+            print_help();
+            exit_code = 0;
+            return false;
+        }
+    }
+
+    // fail if debug was enabled without logging enabled as well
+    if(debug && log_folder == ""){
+        cout << "Debug mode cannot be enabled without logging enabled." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+    // more than one input file, or a list of them, are encoded as a batch
+    if(filelist != ""){
+        std::ifstream list_file(filelist);
+        string line;
+        while(std::getline(list_file, line)){
+            if(line != ""){
+                batch_filenames.push_back(line);
+            }
+        }
+    }
+    // without batches the last -i option is the file to encode
+    batch = accepts('I') && (filelist != "" || batch_filenames.size() > 1);
+    // the input and the output are read and written in order when one of them is a standard stream
+    streaming = !batch && (filename == "-" || output_filename == "-");
+    bool inputs_exist = batch ?
+        !batch_filenames.empty() && std::all_of(batch_filenames.begin(), batch_filenames.end(),
+                                        [](const string &f){return f != "-" && std::filesystem::exists(f);}) :
+        filename != "" && (filename == "-" || std::filesystem::exists(filename));
+    // fail if input file does not exist or is missing
+    if(!inputs_exist){
+        cout << "Input filename is missing or file does not exist." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+    // fail if no output file was given without debug enabled
+    if((output_filename == "" && !debug)){
+        cout << "Output filename is required." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // the legacy header only stores frequencies, so the decoder would not know about the limit
+    if(max_code_length < 0 || max_code_length > HuffmanTree::MAX_CODE_LENGTH
+            || (max_code_length != 0 && header_version == FileHeader::LEGACY)){
+        cout << "Maximum code length must be between 1 and 32 and cannot be used with the legacy header." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // when encoding in blocks the file is never fully in memory, so reading and counting cannot be separated
+    if(debug && block_size != 0){
+        cout << "Debug mode cannot be enabled when encoding in blocks." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // sampling only saves a pass over the file when encoding in blocks, chunks need their exact counts otherwise
+    if(sample_size != 0 && block_size == 0){
+        cout << "Sampling can only be used when encoding in blocks." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // the codes of each block are built from all of its characters
+    if(adaptive && (block_size == 0 || sample_size != 0)){
+        cout << "Codes for each block can only be used when encoding in blocks and without sampling." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // only the chunks of a file in memory are written through the asynchronous writer
+    if((async && block_size != 0) || (direct && !async)){
+        cout << "Asynchronous writes cannot be used when encoding in blocks, direct writes can only be used with asynchronous writes." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // the legacy header has no room for the flag telling that checksums are stored, and the header of a contiguous
+    // bitstream is written before its parts are encoded
+    if(checksums && (header_version == FileHeader::LEGACY || contiguous)){
+        cout << "Checksums cannot be used with the legacy header or with a contiguous bitstream." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // the size of the mapping must be known before encoding, and parts of a contiguous bitstream share bytes
+    if(mapped && (block_size != 0 || contiguous || async)){
+        cout << "The output file cannot be mapped when encoding in blocks, in a contiguous bitstream or with asynchronous writes." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // streams are encoded in blocks with their own codes, see PipeEncoder
+    if(streaming && (debug || header_version == FileHeader::LEGACY || contiguous || positional || sample_size != 0
+                        || adaptive || async || mapped)){
+        cout << "Streams can only be encoded in blocks with their own codes, options -d, -L, -c, -p, -s, -a, -u, -D and -M cannot be used." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+    // files of a batch are encoded in chunks with the codes of the whole file, as by default
+    if(batch && (debug || header_version == FileHeader::LEGACY || contiguous || positional || sample_size != 0
+                    || block_size != 0 || adaptive || async || mapped || output_filename == "-")){
+        cout << "A batch of files is encoded with the default options, options -d, -L, -c, -p, -s, -b, -a, -u, -D and -M cannot be used and the output must be a directory." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+    if(!streaming && (latency != -1 || preload_filename != "")){
+        cout << "Latency and preloaded codes can only be used when reading or writing a stream." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+    if(preload_filename != "" && !std::filesystem::exists(preload_filename)){
+        cout << "File to build the preloaded codes from does not exist." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    vector<int> worker_cpus;
+    if(n_threads <= 0 || !CpuTopology().placement(affinity, n_threads, worker_cpus)){
+        cout << "The number of threads must be positive and the placement one of compact, scatter, none or a list of CPUs the process can use." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // the length of the standard input is not known
+    filesize = filename == "-" || batch ? 0 : std::filesystem::file_size(filename);
+
+    // the legacy header stores sizes and frequencies as ints and can only describe chunks of even length
+    if(header_version == FileHeader::LEGACY && (filesize > INT_MAX || block_size != 0)){
+        cout << "The legacy header cannot be used with files larger than 2GB or with blocks." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    // each file of a batch is saved in the output directory with the extension .dat, so names must be different
+    for(auto &f : batch_filenames){
+        batch_outputs.push_back((std::filesystem::path(output_filename) / std::filesystem::path(f).filename().replace_extension(".dat")).string());
+    }
+    vector<string> sorted_outputs = batch_outputs;
+    std::sort(sorted_outputs.begin(), sorted_outputs.end());
+    if(batch && std::adjacent_find(sorted_outputs.begin(), sorted_outputs.end()) != sorted_outputs.end()){
+        cout << "Files of a batch must have different names, their encodings are saved in the same directory." << endl;
+        print_help();
+        exit_code = 0;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file encoder_options.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class parsing and validating the options of the encoders
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "file_header.hpp"
+
+
+/**
+ * @brief class storing the options of the encoders, read from the command line
+ *
+ * Each encoder accepts the subset of the options it implements, given as a getopt string, the others keep their
+ * default. The options are only read by the encoder once parse succeeds, combinations which cannot be used together
+ * are rejected by parse. The input is encoded in one of the modes, checked in order: a stream if the input or the output
+ * is a standard stream, a batch if more than one file is given, in blocks with their own codes if adaptive is set,
+ * in blocks if block_size is not 0 and in chunks of a file in memory otherwise.
+ *
+ */
+class EncoderOptions{
+    public:
+        /**
+         * @brief path of the file to encode, - for the standard input
+         *
+         */
+        std::string filename = "";
+        /**
+         * @brief path of the encoded file, - for the standard output, or directory of the encoded files of a batch
+         *
+         */
+        std::string output_filename = "";
+        /**
+         * @brief number of threads to use
+         *
+         */
+        int n_threads = 4;
+        /**
+         * @brief whether times and sizes are reported
+         *
+         */
+        bool verbose = false;
+        /**
+         * @brief directory logs are written to, empty if logging is not enabled
+         *
+         */
+        std::string log_folder = "";
+        /**
+         * @brief version of the header of the encoded file
+         *
+         */
+        int header_version = FileHeader::CANONICAL_64;
+        /**
+         * @brief maximum length of the codes, 0 if not limited
+         *
+         */
+        int max_code_length = 0;
+        /**
+         * @brief size of the blocks the file is read in, 0 if the whole file is loaded in memory
+         *
+         */
+        uint64_t block_size = 0;
+        /**
+         * @brief number of characters the codes are built from, 0 if all the characters are counted
+         *
+         */
+        uint64_t sample_size = 0;
+        /**
+         * @brief whether the output is written asynchronously with io_uring
+         *
+         */
+        bool async = false;
+        /**
+         * @brief whether whole pages of the output bypass the page cache, only with async
+         *
+         */
+        bool direct = false;
+        /**
+         * @brief whether the output file is mapped in memory and encoded in place
+         *
+         */
+        bool mapped = false;
+        /**
+         * @brief maximum time in msecs a block waits for more characters when streaming, -1 if not given
+         *
+         */
+        long latency = -1;
+        /**
+         * @brief file the preloaded codes are built from when streaming, empty if there are none
+         *
+         */
+        std::string preload_filename = "";
+        /**
+         * @brief files to encode as a batch, from the -i options and from the list given with -I
+         *
+         */
+        std::vector<std::string> batch_filenames;
+        /**
+         * @brief paths of the encoded files of a batch, one for each file
+         *
+         */
+        std::vector<std::string> batch_outputs;
+        /**
+         * @brief placement of the threads on the CPUs, see CpuTopology::placement. Threads are not pinned by default
+         *
+         */
+        std::string affinity = "none";
+        /**
+         * @brief whether each thread reads its own chunk instead of using a mapping of the file
+         *
+         */
+        bool positional = false;
+        /**
+         * @brief whether the chunks are encoded as a single bitstream instead of one bitstream each
+         *
+         */
+        bool contiguous = false;
+        /**
+         * @brief whether each block has its own codes instead of using the codes of the whole file
+         *
+         */
+        bool adaptive = false;
+        /**
+         * @brief whether the header and each chunk store their checksum
+         *
+         */
+        bool checksums = false;
+        /**
+         * @brief whether frequencies are counted after reading the whole file, only when logging
+         *
+         */
+        bool debug = false;
+        /**
+         * @brief whether more than one file, or a list of them, is encoded
+         *
+         */
+        bool batch = false;
+        /**
+         * @brief whether the input or the output is a standard stream, so that they are read and written in order
+         *
+         */
+        bool streaming = false;
+        /**
+         * @brief size of the file to encode, 0 for a stream or a batch
+         *
+         */
+        uint64_t filesize = 0;
+
+        /**
+         * @brief getopt string of all the options, the ones accepted by par_hc
+         *
+         */
+        static constexpr const char *ALL_OPTIONS = "hi:I:o:t:vl:dLm:b:pcs:aA:uDMF:P:k";
+
+        EncoderOptions(const std::string &accepted = ALL_OPTIONS);
+
+        void print_help() const;
+
+        bool parse(int argc, char *argv[], int &exit_code);
+    private:
+        // getopt string of the options accepted by the encoder
+        std::string accepted;
+
+        bool accepts(char opt) const;
+};
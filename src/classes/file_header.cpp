@@ -0,0 +1,619 @@
+/**
+ * @file file_header.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class describing the header of an encoded file
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "file_header.hpp"
+#include "crc32c.hpp"
+#include <cstring>
+#include <algorithm>
+
+
+/**
+ * @brief magic bytes at the start of versioned headers
+ *
+ */
+static const char MAGIC[3] = {'H', 'C', 'F'};
+
+/**
+ * @brief table of code lengths stored as 4 bits for each character
+ *
+ */
+static const uint8_t TABLE_PACKED = 0;
+/**
+ * @brief table of code lengths stored as a list of (character, length) pairs
+ *
+ */
+static const uint8_t TABLE_SPARSE = 1;
+/**
+ * @brief no table stored, the chunk uses the table of the previous chunk. Only used in adaptive headers
+ *
+ */
+static const uint8_t TABLE_PREVIOUS = 2;
+
+/**
+ * @brief helper function appending the bytes of a value to a buffer
+ *
+ * @tparam T type of the value
+ * @param buffer buffer to append to
+ * @param value value to append
+ */
+template<typename T>
+static void append(std::vector<char> &buffer, T value){
+    size_t pos = buffer.size();
+    buffer.resize(pos + sizeof(value));
+    std::memcpy(&buffer[pos], &value, sizeof(value));
+}
+
+/**
+ * @brief helper function reading a value from a buffer
+ *
+ * @tparam T type of the value
+ * @param buffer buffer to read from
+ * @param size size of the buffer
+ * @param pos position to read from, advanced past the value
+ * @param value where to store the value read
+ * @return true if the buffer contains the whole value
+ * @return false otherwise
+ */
+template<typename T>
+static bool extract(const char *buffer, size_t size, size_t &pos, T &value){
+    if(pos + sizeof(value) > size){
+        return false;
+    }
+    std::memcpy(&value, buffer + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+/**
+ * @brief helper function appending a table of code lengths to a buffer
+ *
+ * @param buffer buffer to append to
+ * @param code_lengths lengths of the codes of the characters, 0 if the character is absent
+ */
+static void append_table(std::vector<char> &buffer, const std::vector<int> &code_lengths){
+    int n_symbols = 0;
+    int max_length = 0;
+    for(auto &l : code_lengths){
+        if(l != 0){
+            n_symbols++;
+        }
+        max_length = std::max(max_length, l);
+    }
+
+    // packed table takes 128 bytes, sparse table takes 2 bytes for each character plus its size
+    if(max_length < 16 && 2 + 2 * n_symbols > 128){
+        append(buffer, TABLE_PACKED);
+        for(int i=0; i<256; i+=2){
+            append(buffer, uint8_t(code_lengths[i] | (code_lengths[i+1] << 4)));
+        }
+    }
+    else{
+        append(buffer, TABLE_SPARSE);
+        append(buffer, uint16_t(n_symbols));
+        for(int i=0; i<256; i++){
+            if(code_lengths[i] != 0){
+                append(buffer, uint8_t(i));
+                append(buffer, uint8_t(code_lengths[i]));
+            }
+        }
+    }
+}
+
+/**
+ * @brief helper function reading a table of code lengths from a buffer
+ *
+ * The lengths are checked to describe a valid prefix code.
+ *
+ * @param buffer buffer to read from
+ * @param size size of the buffer
+ * @param pos position to read from, advanced past the table
+ * @param table_type type of the table, read before calling the function
+ * @param code_lengths where to store the lengths of the codes, 256 elements
+ * @return true if the table is valid
+ * @return false otherwise
+ */
+static bool extract_table(const char *buffer, size_t size, size_t &pos, uint8_t table_type, std::vector<int> &code_lengths){
+    code_lengths.assign(256, 0);
+    if(table_type == TABLE_PACKED){
+        for(int i=0; i<256; i+=2){
+            uint8_t lengths;
+            if(!extract(buffer, size, pos, lengths)){
+                return false;
+            }
+            code_lengths[i] = lengths & 0xF;
+            code_lengths[i+1] = lengths >> 4;
+        }
+    }
+    else if(table_type == TABLE_SPARSE){
+        uint16_t n_symbols;
+        if(!extract(buffer, size, pos, n_symbols) || n_symbols > 256){
+            return false;
+        }
+        for(int i=0; i<n_symbols; i++){
+            uint8_t ch, length;
+            if(!extract(buffer, size, pos, ch) || !extract(buffer, size, pos, length)){
+                return false;
+            }
+            code_lengths[ch] = length;
+        }
+    }
+    else{
+        return false;
+    }
+
+    // the lengths must satisfy Kraft's inequality, otherwise the codes are not a prefix code
+    uint64_t kraft_sum = 0;
+    for(auto &l : code_lengths){
+        if(l > 32){
+            return false;
+        }
+        if(l != 0){
+            kraft_sum += uint64_t(1) << (32 - l);
+        }
+    }
+    return kraft_sum <= (uint64_t(1) << 32);
+}
+
+/**
+ * @brief helper function reading the checksum stored after some bytes and comparing it with their checksum
+ *
+ * @param buffer buffer starting with the checksummed bytes
+ * @param size size of the buffer
+ * @param pos number of checksummed bytes, advanced past the checksum
+ * @return true if the checksums match
+ * @return false if they do not or the buffer is too short
+ */
+static bool extract_checksum(const char *buffer, size_t size, size_t &pos){
+    uint32_t stored;
+    size_t data_size = pos;
+    return extract(buffer, size, pos, stored) && stored == crc32c(buffer, data_size);
+}
+
+
+/**
+ * @brief Construct a new empty File Header:: File Header object, to be filled by parse
+ *
+ */
+FileHeader::FileHeader(){}
+
+/**
+ * @brief Construct a new File Header:: File Header object
+ *
+ * Legacy headers store frequencies as ints, so they cannot describe files longer than INT_MAX characters.
+ * 
+ * @param version version of the header, LEGACY, CANONICAL or CANONICAL_64
+ * @param n_chunks number of chunks the file is encoded in
+ * @param char_counts vector containing the frequencies of the characters
+ * @param ht Huffman tree built from char_counts
+ * @param chunk_chars number of characters of each chunk apart from the last one, 0 to split characters evenly.
+ * Only versions from CANONICAL_64 support chunks which are not even
+ */
+FileHeader::FileHeader(int version, int n_chunks, const std::vector<uint64_t> &char_counts, HuffmanTree &ht, uint64_t chunk_chars){
+    this->version = version;
+    this->n_chunks = n_chunks;
+    this->char_counts = char_counts;
+    this->code_lengths = ht.getCodeLengths();
+    for(auto &c : char_counts){
+        n_chars += c;
+    }
+    this->chunk_chars = chunk_chars;
+    this->even_chunks = chunk_chars == 0;
+    if(even_chunks){
+        this->chunk_chars = n_chars / n_chunks;
+    }
+}
+
+/**
+ * @brief Construct a new adaptive File Header:: File Header object, storing no table of codes
+ *
+ * Each chunk stores its own table or uses the one of the previous chunk, see serializeChunk.
+ *
+ * @param n_chunks number of chunks the file is encoded in
+ * @param n_chars number of characters of the original file
+ * @param chunk_chars number of characters of each chunk apart from the last one
+ */
+FileHeader::FileHeader(int n_chunks, uint64_t n_chars, uint64_t chunk_chars){
+    this->version = ADAPTIVE;
+    this->n_chunks = n_chunks;
+    this->n_chars = n_chars;
+    this->chunk_chars = chunk_chars;
+    this->even_chunks = false;
+}
+
+/**
+ * @brief Construct a new stream File Header:: File Header object, storing neither the length of the file nor its codes
+ *
+ * Each chunk stores its number of characters and its own table or uses the one of the previous chunk,
+ * see serializeChunk.
+ *
+ * @param chunk_chars maximum number of characters of a chunk
+ */
+FileHeader::FileHeader(uint64_t chunk_chars){
+    this->version = STREAM;
+    this->n_chunks = 0;
+    this->chunk_chars = chunk_chars;
+    this->even_chunks = false;
+}
+
+/**
+ * @brief getter method for the version of the header
+ *
+ * @return int
+ */
+int FileHeader::getVersion(){return version;}
+/**
+ * @brief getter method for the number of characters of the original file
+ *
+ * @return uint64_t
+ */
+uint64_t FileHeader::getNChars(){return n_chars;}
+/**
+ * @brief getter method for the number of chunks
+ *
+ * @return int
+ */
+int FileHeader::getNChunks(){return n_chunks;}
+/**
+ * @brief method computing the number of characters of a chunk
+ *
+ * @param chunk index of the chunk
+ * @return uint64_t number of characters encoded in the chunk
+ */
+uint64_t FileHeader::getChunkChars(int chunk){
+    if(chunk == n_chunks - 1){
+        return n_chars - chunk_chars * (n_chunks - 1);
+    }
+    return chunk_chars;
+}
+
+/**
+ * @brief setter method for the number of characters of the original file, needed when the frequencies
+ * are estimated and do not add up to it. Cannot be used with legacy headers, which only store the frequencies
+ *
+ * @param n_chars number of characters of the original file
+ */
+void FileHeader::setNChars(uint64_t n_chars){
+    this->n_chars = n_chars;
+    if(even_chunks){
+        chunk_chars = n_chars / n_chunks;
+    }
+}
+
+/**
+ * @brief method returning the table of encodings to use with this header
+ *
+ * Legacy headers rebuild the Huffman tree from the frequencies, canonical headers
+ * compute the codes directly from their lengths. Adaptive headers have no codes, see parseChunk.
+ *
+ * @return std::vector<std::pair<int, int>> table of encodings
+ */
+std::vector<std::pair<int, int>> FileHeader::getCodes(){
+    if(version == LEGACY){
+        HuffmanTree ht(char_counts);
+        return ht.getCodes();
+    }
+    return HuffmanTree::canonicalCodes(code_lengths);
+}
+
+/**
+ * @brief getter method for whether the file stores checksums
+ *
+ * @return bool
+ */
+bool FileHeader::hasChecksums(){return checksums;}
+
+/**
+ * @brief setter method for whether the file stores checksums, ignored by legacy headers which cannot store them
+ *
+ * @param checksums true to store a checksum of the header and of each chunk
+ */
+void FileHeader::setChecksums(bool checksums){
+    this->checksums = checksums && version != LEGACY;
+}
+
+/**
+ * @brief method deciding whether a chunk is stored raw, because its encoding saves less than RAW_GAIN percent
+ * of its size. Legacy and version 1 headers do not support raw chunks
+ *
+ * @param n_bits number of bits of the encoded chunk, along with the codes it stores for adaptive headers
+ * @param chunk_chars number of characters of the chunk
+ * @return true if the chunk is stored raw
+ * @return false if it is encoded
+ */
+bool FileHeader::storeRaw(uint64_t n_bits, uint64_t chunk_chars){
+    return version >= CANONICAL_64 && (n_bits + 7) / 8 * 100 > chunk_chars * (100 - RAW_GAIN);
+}
+
+/**
+ * @brief method computing the number of bytes following the header of a chunk, stored raw or encoded
+ *
+ * @param n_bits number of bits of the encoded chunk
+ * @param chunk_chars number of characters of the chunk
+ * @return uint64_t size of the chunk in bytes
+ */
+uint64_t FileHeader::storedSize(uint64_t n_bits, uint64_t chunk_chars){
+    return storeRaw(n_bits, chunk_chars) ? chunk_chars : (n_bits + 7) / 8;
+}
+
+/**
+ * @brief method converting the header to the bytes to write to file
+ *
+ * @return std::vector<char> serialized header
+ */
+std::vector<char> FileHeader::serialize(){
+    std::vector<char> buffer;
+    if(version == LEGACY){
+        append(buffer, n_chunks);
+        for(auto &c : char_counts){
+            append(buffer, int(c));
+        }
+        return buffer;
+    }
+
+    for(auto &c : MAGIC){
+        append(buffer, c);
+    }
+    append(buffer, uint8_t(checksums ? version | CHECKSUM_FLAG : version));
+    // stream headers only store the maximum size of the chunks
+    if(version == STREAM){
+        append(buffer, chunk_chars);
+        if(checksums){
+            append(buffer, crc32c(buffer.data(), buffer.size()));
+        }
+        return buffer;
+    }
+    append(buffer, n_chars);
+    append(buffer, n_chunks);
+    if(version >= CANONICAL_64){
+        append(buffer, chunk_chars);
+    }
+    // adaptive headers store the tables in the chunks
+    if(version != ADAPTIVE){
+        append_table(buffer, code_lengths);
+    }
+    if(checksums){
+        append(buffer, crc32c(buffer.data(), buffer.size()));
+    }
+    return buffer;
+}
+
+/**
+ * @brief method reading the header from the start of an encoded file
+ *
+ * Files starting with the magic bytes are read as versioned headers, all the others as legacy headers.
+ * The lengths of canonical codes are checked to describe a valid prefix code, and the checksum of the header
+ * if the file stores checksums. Each character takes at least a bit, so headers claiming more characters than
+ * the file can hold are rejected before anything is allocated for them.
+ *
+ * @param buffer buffer containing the whole encoded file
+ * @param size size of the file
+ * @return size_t size of the header in bytes, 0 if the header is not valid
+ */
+size_t FileHeader::parse(const char *buffer, size_t size){
+    size_t pos = 0;
+    char_counts.assign(256, 0);
+    code_lengths.assign(256, 0);
+    n_chars = 0;
+    checksums = false;
+
+    if(size < sizeof(MAGIC) || std::memcmp(buffer, MAGIC, sizeof(MAGIC)) != 0){
+        version = LEGACY;
+        if(!extract(buffer, size, pos, n_chunks)){
+            return 0;
+        }
+        for(auto &c : char_counts){
+            int count;
+            if(!extract(buffer, size, pos, count) || count < 0){
+                return 0;
+            }
+            c = count;
+            n_chars += c;
+        }
+        if(n_chunks <= 0 || n_chars / 8 > size){
+            return 0;
+        }
+        chunk_chars = n_chars / n_chunks;
+        return pos;
+    }
+
+    pos += sizeof(MAGIC);
+    uint8_t file_version;
+    uint8_t table_type;
+    if(!extract(buffer, size, pos, file_version)){
+        return 0;
+    }
+    checksums = (file_version & CHECKSUM_FLAG) != 0;
+    file_version &= ~CHECKSUM_FLAG;
+    if(file_version < CANONICAL || file_version > STREAM){
+        return 0;
+    }
+    version = file_version;
+    if(version == STREAM){
+        n_chunks = 0;
+        if(!extract(buffer, size, pos, chunk_chars) || chunk_chars == 0){
+            return 0;
+        }
+        if(checksums && !extract_checksum(buffer, size, pos)){
+            return 0;
+        }
+        return pos;
+    }
+    if(!extract(buffer, size, pos, n_chars) || !extract(buffer, size, pos, n_chunks) || n_chunks <= 0 || n_chars / 8 > size){
+        return 0;
+    }
+    chunk_chars = n_chars / n_chunks;
+    if(version >= CANONICAL_64){
+        if(!extract(buffer, size, pos, chunk_chars) || (chunk_chars != 0 && n_chunks - 1 > n_chars / chunk_chars)){
+            return 0;
+        }
+    }
+    if(version == ADAPTIVE){
+        if(checksums && !extract_checksum(buffer, size, pos)){
+            return 0;
+        }
+        return pos;
+    }
+    if(!extract(buffer, size, pos, table_type) || !extract_table(buffer, size, pos, table_type, code_lengths)){
+        return 0;
+    }
+    if(checksums && !extract_checksum(buffer, size, pos)){
+        return 0;
+    }
+    return pos;
+}
+
+/**
+ * @brief method converting the header of a chunk to the bytes to write to file
+ *
+ * Chunks of adaptive and stream headers are followed by the table of the chunk, or by a byte telling that
+ * the chunk uses the table of the previous one. Chunks of stream headers start with their number of characters.
+ * If the file stores checksums the header ends with the checksum of its other bytes followed by the bytes of the chunk,
+ * so it has to be serialized after the chunk is encoded. Serializing it before only gives its size.
+ *
+ * @param chunk_size size in bytes of the encoded chunk
+ * @param padding number of padding bits at the end of the chunk
+ * @param code_lengths lengths of the codes used by the chunk, nullptr if the chunk uses the table of the
+ * previous one. Only used with adaptive and stream headers
+ * @param chunk_chars number of characters of the chunk, 0 for the chunk ending the file. Only used with stream headers
+ * @param chunk_data bytes of the chunk, chunk_size of them, nullptr if they are not known yet.
+ * Only used with checksums
+ * @return std::vector<char> serialized header of the chunk
+ */
+std::vector<char> FileHeader::serializeChunk(uint64_t chunk_size, char padding, const std::vector<int> *code_lengths,
+                                                uint64_t chunk_chars, const char *chunk_data){
+    std::vector<char> buffer;
+    if(version == STREAM){
+        append(buffer, chunk_chars);
+    }
+    if(version >= CANONICAL_64){
+        append(buffer, chunk_size);
+    }
+    else{
+        append(buffer, int(chunk_size));
+    }
+    append(buffer, padding);
+    if(version >= ADAPTIVE){
+        if(code_lengths == nullptr){
+            append(buffer, TABLE_PREVIOUS);
+        }
+        else{
+            append_table(buffer, *code_lengths);
+        }
+    }
+    if(checksums){
+        uint32_t crc = crc32c(buffer.data(), buffer.size());
+        append(buffer, chunk_data == nullptr ? crc : crc32c(chunk_data, chunk_size, crc));
+    }
+    return buffer;
+}
+
+/**
+ * @brief method reading the header of a chunk
+ *
+ * The chunk must fit in the buffer and be able to hold its characters: every code takes at least a bit,
+ * and raw chunks store exactly one byte for each character. Decoders can then size their outputs from the
+ * number of characters of the chunks, which cannot be more than 8 times the size of the encoded file.
+ *
+ * @param buffer buffer containing the header of the chunk followed by the chunk and the rest of the file
+ * @param size size of the buffer
+ * @param chunk index of the chunk, unused with stream headers
+ * @param chunk_size where to store the size in bytes of the encoded chunk
+ * @param padding where to store the number of padding bits at the end of the chunk
+ * @param code_lengths where to store the lengths of the codes used by the chunk, left empty if the chunk uses
+ * the table of the previous one. Required with adaptive and stream headers, unused otherwise
+ * @param chunk_chars where to store the number of characters of the chunk, 0 for the chunk ending the file.
+ * Required with stream headers, which store it in the chunk, optional otherwise
+ * @return size_t size of the header of the chunk in bytes, 0 if the buffer is too short, the table is not valid
+ * or the chunk cannot hold its characters. The checksum is skipped, see verifyChunk
+ */
+size_t FileHeader::parseChunk(const char *buffer, size_t size, int chunk, uint64_t &chunk_size, char &padding,
+                                std::vector<int> *code_lengths, uint64_t *chunk_chars){
+    size_t pos = 0;
+    uint64_t n_chunk_chars = 0;
+    if(version == STREAM){
+        if(!extract(buffer, size, pos, n_chunk_chars) || n_chunk_chars > this->chunk_chars){
+            return 0;
+        }
+    }
+    else{
+        n_chunk_chars = getChunkChars(chunk);
+    }
+    if(chunk_chars != nullptr){
+        *chunk_chars = n_chunk_chars;
+    }
+    if(version >= CANONICAL_64){
+        if(!extract(buffer, size, pos, chunk_size)){
+            return 0;
+        }
+    }
+    else{
+        int int_size;
+        if(!extract(buffer, size, pos, int_size) || int_size < 0){
+            return 0;
+        }
+        chunk_size = int_size;
+    }
+    if(!extract(buffer, size, pos, padding)){
+        return 0;
+    }
+    if(version >= ADAPTIVE){
+        uint8_t table_type;
+        if(code_lengths == nullptr || !extract(buffer, size, pos, table_type)){
+            return 0;
+        }
+        if(table_type == TABLE_PREVIOUS){
+            code_lengths->clear();
+        }
+        else if(!extract_table(buffer, size, pos, table_type, *code_lengths)){
+            return 0;
+        }
+    }
+    if(checksums){
+        pos += sizeof(uint32_t);
+        if(pos > size){
+            return 0;
+        }
+    }
+    if(chunk_size > size - pos){
+        return 0;
+    }
+    if(padding == RAW_CHUNK){
+        return version >= CANONICAL_64 && chunk_size == n_chunk_chars ? pos : 0;
+    }
+    // empty encodings count as a byte of padding, see BitWriter::padding
+    if(chunk_size == 0){
+        return padding >= 0 && padding <= 8 && n_chunk_chars == 0 ? pos : 0;
+    }
+    if(padding < 0 || padding > 7 || n_chunk_chars > chunk_size * 8 - padding){
+        return 0;
+    }
+    return pos;
+}
+
+/**
+ * @brief method checking the checksum of a chunk, always successful if the file stores no checksums
+ *
+ * @param chunk_header header of the chunk, as read by parseChunk
+ * @param header_size size of the header of the chunk returned by parseChunk
+ * @param chunk_data bytes of the chunk
+ * @param chunk_size size in bytes of the chunk
+ * @return true if the checksum matches
+ * @return false if the header or the bytes of the chunk are corrupted
+ */
+bool FileHeader::verifyChunk(const char *chunk_header, size_t header_size, const char *chunk_data, uint64_t chunk_size){
+    if(!checksums){
+        return true;
+    }
+    if(header_size < sizeof(uint32_t)){
+        return false;
+    }
+    uint32_t stored;
+    size_t data_size = header_size - sizeof(uint32_t);
+    std::memcpy(&stored, chunk_header + data_size, sizeof(stored));
+    return stored == crc32c(chunk_data, chunk_size, crc32c(chunk_header, data_size));
+}
@@ -0,0 +1,162 @@
+/**
+ * @file file_header.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class describing the header of an encoded file
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "huffman_tree.hpp"
+
+
+/**
+ * @brief class containing the metadata needed to decode an encoded file
+ *
+ * Five versions of the header exist:
+ * - version 0 (legacy): number of chunks as an int followed by the frequency of each character as 256 ints.
+ *   The decoder has to rebuild the Huffman tree to obtain the codes.
+ * - version 1 (canonical): the magic bytes "HCF", a byte with the version, the number of characters as a 64 bit
+ *   integer, the number of chunks as an int and the lengths of the canonical codes. Lengths are stored either
+ *   as 4 bits for each character or as a list of (character, length) pairs, whichever is smaller.
+ * - version 2 (canonical, 64 bit): same as version 1 with the number of characters of each chunk as a 64 bit integer
+ *   after the number of chunks.
+ * - version 3 (adaptive): same as version 2 without the lengths of the codes, each chunk stores its own.
+ * - version 4 (stream): the magic bytes, the version and the maximum number of characters of a chunk as a 64 bit
+ *   integer. The length of the file is not known when the header is written, so each chunk starts with its
+ *   number of characters as a 64 bit integer followed by the header of an adaptive chunk. A chunk with no
+ *   characters ends the file.
+ *
+ * The header is followed by the chunks, each made of its size in bytes, the number of padding bits as a char and
+ * the encoded bits. The size is an int up to version 1 and a 64 bit integer from version 2.
+ * In version 3 the padding is followed by the lengths of the codes of the chunk, stored as in the file header,
+ * or by a single byte telling that the chunk uses the codes of the previous one.
+ * From version 2 a chunk with RAW_CHUNK as padding stores its characters as they are, its size is its number of
+ * characters. Raw chunks of adaptive files store no codes and do not change the codes used by the next chunks.
+ * Versioned headers can store checksums, telling so with CHECKSUM_FLAG in the byte of the version. The header is then
+ * followed by the CRC32C of its bytes, and the header of each chunk ends with the CRC32C of its other bytes followed
+ * by the bytes of the chunk, so that chunks can be verified without decoding them.
+ * All the chunks contain the same number of characters apart from the last one, which contains the remaining ones.
+ * Before version 2 the number of characters of each chunk is the total divided by the number of chunks.
+ *
+ */
+class FileHeader{
+    private:
+        /**
+         * @brief version of the header
+         *
+         */
+        int version = CANONICAL_64;
+        /**
+         * @brief number of characters of the original file
+         *
+         */
+        uint64_t n_chars = 0;
+        /**
+         * @brief number of chunks the file was encoded in
+         *
+         */
+        int n_chunks = 0;
+        /**
+         * @brief number of characters of each chunk apart from the last one
+         *
+         */
+        uint64_t chunk_chars = 0;
+        /**
+         * @brief whether the characters are split evenly between the chunks
+         *
+         */
+        bool even_chunks = true;
+        /**
+         * @brief frequencies of the characters, only stored in legacy headers
+         *
+         */
+        std::vector<uint64_t> char_counts = std::vector<uint64_t>(256, 0);
+        /**
+         * @brief lengths of the codes of the characters, 0 if the character is absent
+         *
+         */
+        std::vector<int> code_lengths = std::vector<int>(256, 0);
+        /**
+         * @brief whether the header and the chunks store checksums
+         *
+         */
+        bool checksums = false;
+
+    public:
+        /**
+         * @brief version of the header storing the frequencies of the characters
+         *
+         */
+        static const int LEGACY = 0;
+        /**
+         * @brief version of the header storing the lengths of the canonical codes
+         *
+         */
+        static const int CANONICAL = 1;
+        /**
+         * @brief version of the header storing the lengths of the canonical codes and 64 bit sizes
+         *
+         */
+        static const int CANONICAL_64 = 2;
+        /**
+         * @brief version of the header storing the lengths of the canonical codes of each chunk
+         *
+         */
+        static const int ADAPTIVE = 3;
+        /**
+         * @brief version of the header of a stream of chunks of unknown length, each storing its own codes
+         *
+         */
+        static const int STREAM = 4;
+        /**
+         * @brief number of characters of each chunk written by the parallel encoders, chunks do not depend
+         * on the number of threads so that the encoded file does not either
+         *
+         */
+        static const uint64_t DEFAULT_CHUNK_CHARS = 1 << 20;
+        /**
+         * @brief padding marking a chunk stored without encoding
+         *
+         */
+        static const char RAW_CHUNK = -1;
+        /**
+         * @brief minimum percentage of its size a chunk has to save to be encoded, otherwise it is stored raw
+         *
+         */
+        static const int RAW_GAIN = 1;
+        /**
+         * @brief bit set in the byte of the version when the file stores checksums
+         *
+         */
+        static const uint8_t CHECKSUM_FLAG = 0x80;
+
+        FileHeader();
+        FileHeader(int version, int n_chunks, const std::vector<uint64_t> &char_counts, HuffmanTree &ht, uint64_t chunk_chars = 0);
+        FileHeader(int n_chunks, uint64_t n_chars, uint64_t chunk_chars);
+        explicit FileHeader(uint64_t chunk_chars);
+
+        int getVersion();
+        uint64_t getNChars();
+        int getNChunks();
+        uint64_t getChunkChars(int chunk);
+        void setNChars(uint64_t n_chars);
+        bool hasChecksums();
+        void setChecksums(bool checksums);
+        std::vector<std::pair<int, int>> getCodes();
+        bool storeRaw(uint64_t n_bits, uint64_t chunk_chars);
+        uint64_t storedSize(uint64_t n_bits, uint64_t chunk_chars);
+
+        std::vector<char> serialize();
+        size_t parse(const char *buffer, size_t size);
+        std::vector<char> serializeChunk(uint64_t chunk_size, char padding, const std::vector<int> *code_lengths = nullptr,
+                                            uint64_t chunk_chars = 0, const char *chunk_data = nullptr);
+        size_t parseChunk(const char *buffer, size_t size, int chunk, uint64_t &chunk_size, char &padding,
+                            std::vector<int> *code_lengths = nullptr, uint64_t *chunk_chars = nullptr);
+        bool verifyChunk(const char *chunk_header, size_t header_size, const char *chunk_data, uint64_t chunk_size);
+};
@@ -0,0 +1,136 @@
+/**
+ * @file histogram.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the functions counting the characters of a buffer or of a sample of a file
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "histogram.hpp"
+#include <cstring>
+#include <algorithm>
+
+
+/**
+ * @brief number of interleaved histograms, consecutive characters are counted in different ones
+ *
+ */
+static const int N_TABLES = 8;
+
+/**
+ * @brief maximum number of characters counted before the partial histograms are added to the totals,
+ * so that their 32 bit counters cannot overflow
+ *
+ */
+static const size_t BATCH_SIZE = size_t(1) << 31;
+
+/**
+ * @brief size of the contiguous pieces read from the file when sampling
+ *
+ */
+static const size_t SAMPLE_PIECE_SIZE = 64 * 1024;
+
+/**
+ * @brief helper function counting the characters of a batch of at most BATCH_SIZE characters
+ *
+ * @param data pointer to the characters to count
+ * @param size number of characters to count
+ * @param char_counts vector of 256 counters to add the counts to
+ */
+static void count_batch(const unsigned char *data, size_t size, std::vector<uint64_t> &char_counts){
+    uint32_t tables[N_TABLES][256] = {};
+    size_t i = 0;
+
+    // 16 characters are loaded at a time and each byte of a word goes to its own table
+    for(; i + 16 <= size; i += 16){
+        uint64_t w0, w1;
+        std::memcpy(&w0, data + i, sizeof(w0));
+        std::memcpy(&w1, data + i + 8, sizeof(w1));
+        for(int j=0; j<N_TABLES; j++){
+            tables[j][(w0 >> (8 * j)) & 0xFF]++;
+        }
+        for(int j=0; j<N_TABLES; j++){
+            tables[j][(w1 >> (8 * j)) & 0xFF]++;
+        }
+    }
+    for(; i < size; i++){
+        tables[0][data[i]]++;
+    }
+
+    for(int c=0; c<256; c++){
+        uint64_t sum = 0;
+        for(int j=0; j<N_TABLES; j++){
+            sum += tables[j][c];
+        }
+        char_counts[c] += sum;
+    }
+}
+
+/**
+ * @brief function counting the characters of a buffer
+ *
+ * Incrementing a single counter for each character stalls when consecutive characters are equal, which is common
+ * in text, since each increment has to wait for the previous one to be stored. Characters are instead counted in
+ * several interleaved histograms, so that consecutive increments usually touch different counters, and the
+ * histograms are summed at the end.
+ *
+ * @param data pointer to the characters to count
+ * @param size number of characters to count
+ * @param char_counts vector of 256 counters to add the counts to
+ */
+void count_bytes(const unsigned char *data, size_t size, std::vector<uint64_t> &char_counts){
+    while(size > 0){
+        size_t batch = size < BATCH_SIZE ? size : BATCH_SIZE;
+        count_batch(data, batch, char_counts);
+        data += batch;
+        size -= batch;
+    }
+}
+
+/**
+ * @brief function estimating the frequencies of the characters of a file from a sample
+ *
+ * The sample is made of pieces of contiguous characters evenly spread over the file, the whole file is counted
+ * if it is not larger than the sample. Characters missing from the sample are given a count of 1, so that every
+ * character has a code and any file can be encoded, at the cost of long codes for characters which are rare.
+ * The counts are proportional to the frequencies, but their sum is not the number of characters of the file.
+ *
+ * @param file file to sample
+ * @param sample_size number of characters to count
+ * @param char_counts vector where to store the estimated frequencies of the characters
+ * @return true if the sample was read
+ * @return false otherwise
+ */
+bool sample_bytes(InputFile &file, uint64_t sample_size, std::vector<uint64_t> &char_counts){
+    char_counts.assign(256, 0);
+    uint64_t filesize = file.size();
+    std::vector<unsigned char> buffer;
+
+    if(filesize <= sample_size){
+        buffer.resize(filesize);
+        if(!file.read(0, filesize, buffer.data())){
+            return false;
+        }
+        count_bytes(buffer.data(), buffer.size(), char_counts);
+    }
+    else{
+        size_t piece_size = std::min<uint64_t>(SAMPLE_PIECE_SIZE, sample_size);
+        uint64_t n_pieces = (sample_size + piece_size - 1) / piece_size;
+        buffer.resize(piece_size);
+        for(uint64_t i=0; i<n_pieces; i++){
+            // the first piece starts at the beginning of the file and the last one ends at its end
+            uint64_t offset = n_pieces == 1 ? 0 : (filesize - piece_size) / (n_pieces - 1) * i;
+            if(!file.read(offset, piece_size, buffer.data())){
+                return false;
+            }
+            count_bytes(buffer.data(), buffer.size(), char_counts);
+        }
+    }
+
+    for(auto &c : char_counts){
+        if(c == 0){
+            c = 1;
+        }
+    }
+    return true;
+}
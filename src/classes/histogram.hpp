@@ -0,0 +1,19 @@
+/**
+ * @file histogram.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the functions counting the characters of a buffer or of a sample of a file
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "input_file.hpp"
+
+
+void count_bytes(const unsigned char *data, size_t size, std::vector<uint64_t> &char_counts);
+bool sample_bytes(InputFile &file, uint64_t sample_size, std::vector<uint64_t> &char_counts);
@@ -0,0 +1,272 @@
+/**
+ * @file huffman_decoder.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the table driven Huffman decoder
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "huffman_decoder.hpp"
+#include <cstring>
+#include <algorithm>
+
+
+/**
+ * @brief helper function loading a word from memory with the most significant byte first
+ *
+ * @param input pointer to the memory to read from, does not need to be aligned
+ * @return uint64_t the word read
+ */
+static inline uint64_t load_word(const unsigned char *input){
+    uint64_t word;
+    std::memcpy(&word, input, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+/**
+ * @brief helper function storing the characters of a table entry to memory
+ *
+ * Always writes 4 bytes, only the first ones are meaningful
+ *
+ * @param output pointer to the memory to write to
+ * @param entry entry of the table
+ */
+static inline void store_chars(unsigned char *output, uint64_t entry){
+    uint32_t chars = uint32_t(entry);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    chars = __builtin_bswap32(chars);
+#endif
+    std::memcpy(output, &chars, sizeof(chars));
+}
+
+/**
+ * @brief Construct a new Huffman Decoder:: Huffman Decoder object
+ *
+ * Builds a trie from the codes and then the lookup tables from the trie.
+ * Characters with a code of length 0 are considered absent.
+ *
+ * @param codes table of encodings as returned by HuffmanTree::getCodes
+ */
+HuffmanDecoder::HuffmanDecoder(const std::vector<std::pair<int, int>> &codes){
+    trie.push_back(std::make_pair(0, 0));
+    for(int ch=0; ch<codes.size(); ch++){
+        int length = codes[ch].first;
+        uint32_t code = codes[ch].second;
+        if(length == 0){
+            continue;
+        }
+        int node = 0;
+        for(int i=length-1; i>=0; i--){
+            int bit = (code >> i) & 1;
+            int child = bit ? trie[node].second : trie[node].first;
+            if(child == 0){
+                child = trie.size();
+                trie.push_back(std::make_pair(0, 0));
+                if(bit){trie[node].second = child;}
+                else{trie[node].first = child;}
+            }
+            node = child;
+        }
+        trie[node] = std::make_pair(-1, ch);
+    }
+
+    table.resize(1 << ROOT_BITS);
+    build_table(0, 0, ROOT_BITS, true);
+
+    // the trie is not needed anymore
+    trie.clear();
+    trie.shrink_to_fit();
+}
+
+/**
+ * @brief helper recursive function computing the depth of a subtree of the trie
+ *
+ * @param node index of the root of the subtree
+ * @return int depth of the subtree, 0 for a leaf
+ */
+int HuffmanDecoder::trie_depth(int node){
+    if(trie[node].first == -1){
+        return 0;
+    }
+    int depth = 0;
+    if(trie[node].first != 0){
+        depth = std::max(depth, trie_depth(trie[node].first) + 1);
+    }
+    if(trie[node].second != 0){
+        depth = std::max(depth, trie_depth(trie[node].second) + 1);
+    }
+    return depth;
+}
+
+/**
+ * @brief helper recursive function filling a lookup table
+ *
+ * Each index of the table is interpreted as a sequence of bits which is used to walk the trie starting from node.
+ * If the walk ends in the middle of the first code, a secondary table is created for the node reached.
+ *
+ * @param offset position of the table inside the vector of tables
+ * @param node trie node from which the codes are read
+ * @param bits number of bits indexing the table
+ * @param multi_symbol whether to decode more than one character for each entry
+ */
+void HuffmanDecoder::build_table(int offset, int node, int bits, bool multi_symbol){
+    for(uint64_t idx=0; idx < (uint64_t(1) << bits); idx++){
+        uint64_t chars = 0;
+        int n_chars = 0;
+        int used_bits = 0;
+        int first_bits = 0;
+        int current = node;
+
+        for(int b=0; b<bits; b++){
+            int bit = (idx >> (bits - 1 - b)) & 1;
+            current = bit ? trie[current].second : trie[current].first;
+            // the bits do not match any code
+            if(current == 0){
+                break;
+            }
+            if(trie[current].first == -1){
+                chars |= uint64_t(trie[current].second) << (8 * n_chars);
+                n_chars++;
+                used_bits = b + 1;
+                if(n_chars == 1){
+                    first_bits = used_bits;
+                }
+                if(!multi_symbol || n_chars == 4){
+                    break;
+                }
+                // following codes are read from the root of the trie
+                current = 0;
+            }
+        }
+
+        uint64_t entry;
+        if(n_chars > 0){
+            entry = chars | (uint64_t(n_chars) << 32) | (uint64_t(used_bits) << 40) | (uint64_t(first_bits) << 48);
+        }
+        else if(current != 0){
+            // the first code is longer than the bits available, link to a new table
+            int sub_bits = std::min(SUB_BITS, trie_depth(current));
+            int sub_offset = table.size();
+            table.resize(table.size() + (size_t(1) << sub_bits));
+            build_table(sub_offset, current, sub_bits, false);
+            entry = uint64_t(sub_offset) | (uint64_t(sub_bits) << 40);
+        }
+        else{
+            // invalid sequence of bits
+            entry = 0;
+        }
+        table[offset + idx] = entry;
+    }
+}
+
+/**
+ * @brief method to decode a bitstream
+ *
+ * Exactly n_chars characters are decoded. The input does not need any padding, if it ends before all
+ * the characters are decoded it is extended with zeros.
+ *
+ * @param input pointer to the encoded bitstream
+ * @param input_size size in bytes of the encoded bitstream
+ * @param output pointer to the buffer to write the characters to, at least n_chars long
+ * @param n_chars number of characters to decode
+ * @return uint64_t number of bits consumed, decoding stops early if an invalid code is found
+ */
+uint64_t HuffmanDecoder::decode(const char *input, size_t input_size, unsigned char *output, size_t n_chars) const{
+    const uint64_t *tab = table.data();
+    const unsigned char *ptr = reinterpret_cast<const unsigned char *>(input);
+    const unsigned char *end = ptr + input_size;
+    unsigned char *out = output;
+    unsigned char *out_end = output + n_chars;
+
+    // bits not yet decoded, aligned to the left
+    uint64_t bitbuf = 0;
+    // number of valid bits in bitbuf
+    int bitcount = 0;
+    // total number of bits consumed
+    uint64_t consumed = 0;
+
+    // loads as many whole bytes as fit in bitbuf
+    auto refill = [&](){
+        if(end - ptr >= 8){
+            bitbuf |= load_word(ptr) >> bitcount;
+            ptr += (63 - bitcount) >> 3;
+            bitcount |= 56;
+        }
+        else{
+            while(bitcount <= 56 && ptr < end){
+                bitbuf |= uint64_t(*ptr) << (56 - bitcount);
+                ptr++;
+                bitcount += 8;
+            }
+            // past the end of the input the stream is made of zeros
+            if(ptr == end){
+                bitcount = 64;
+            }
+        }
+    };
+
+    // follows links until a character is found, returns false on invalid codes
+    auto decode_long = [&](uint64_t entry){
+        int level_bits = ROOT_BITS;
+        while(((entry >> 32) & 0xFF) == 0){
+            int sub_bits = (entry >> 40) & 0xFF;
+            if(sub_bits == 0){
+                return false;
+            }
+            bitbuf <<= level_bits;
+            bitcount -= level_bits;
+            consumed += level_bits;
+            entry = tab[(entry & 0xFFFFFFFF) + (bitbuf >> (64 - sub_bits))];
+            level_bits = sub_bits;
+        }
+        *out++ = entry & 0xFF;
+        int length = (entry >> 48) & 0xFF;
+        bitbuf <<= length;
+        bitcount -= length;
+        consumed += length;
+        return true;
+    };
+
+    // main loop, each lookup can decode up to 4 characters
+    while(out_end - out >= 4){
+        if(bitcount < 32){
+            refill();
+        }
+        uint64_t entry = tab[bitbuf >> (64 - ROOT_BITS)];
+        int n = (entry >> 32) & 0xFF;
+        if(n != 0){
+            store_chars(out, entry);
+            out += n;
+            int length = (entry >> 40) & 0xFF;
+            bitbuf <<= length;
+            bitcount -= length;
+            consumed += length;
+        }
+        else if(!decode_long(entry)){
+            return consumed;
+        }
+    }
+
+    // last characters are decoded one at a time to not write past the end of the output
+    while(out < out_end){
+        if(bitcount < 32){
+            refill();
+        }
+        uint64_t entry = tab[bitbuf >> (64 - ROOT_BITS)];
+        if(((entry >> 32) & 0xFF) != 0){
+            *out++ = entry & 0xFF;
+            int length = (entry >> 48) & 0xFF;
+            bitbuf <<= length;
+            bitcount -= length;
+            consumed += length;
+        }
+        else if(!decode_long(entry)){
+            return consumed;
+        }
+    }
+
+    return consumed;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file huffman_decoder.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class implementing the table driven Huffman decoder
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ * @brief class decoding a Huffman bitstream through lookup tables
+ *
+ * The first ROOT_BITS bits of the stream are used to index the root table, whose entries resolve
+ * up to 4 characters at once. Codes longer than ROOT_BITS are resolved by following links to
+ * secondary tables, each indexed by at most SUB_BITS further bits.
+ * Entries are stored as 64 bit words:
+ * - bits 0-31: decoded characters, the first one in the lowest byte
+ * - bits 32-39: number of decoded characters, 0 if the entry is a link to another table
+ * - bits 40-47: bits consumed by all the decoded characters, or index size of the linked table
+ * - bits 48-55: bits consumed by the first decoded character
+ * For links, bits 0-31 store the offset of the linked table. Entries not matching any code are links to a table
+ * indexed by 0 bits and make decoding stop.
+ * The object is not modified while decoding and can be shared between threads.
+ *
+ */
+class HuffmanDecoder{
+    private:
+        /**
+         * @brief number of bits used to index the root table
+         *
+         */
+        static const int ROOT_BITS = 11;
+        /**
+         * @brief maximum number of bits used to index a secondary table
+         *
+         */
+        static const int SUB_BITS = 8;
+        /**
+         * @brief vector containing the root table followed by all the secondary tables
+         *
+         */
+        std::vector<uint64_t> table;
+        /**
+         * @brief trie built from the codes, used only while building the tables
+         *
+         * Internal nodes store the index of their two children, 0 if missing since the root is never a child.
+         * Leaves store -1 and the character in the second element.
+         *
+         */
+        std::vector<std::pair<int, int>> trie;
+
+        int trie_depth(int node);
+        void build_table(int offset, int node, int bits, bool multi_symbol);
+
+    public:
+        HuffmanDecoder(const std::vector<std::pair<int, int>> &codes);
+        uint64_t decode(const char *input, size_t input_size, unsigned char *output, size_t n_chars) const;
+};
@@ -0,0 +1,557 @@
+/**
+ * @file huffman_service.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class serving compression and decompression requests
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "huffman_service.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "huffman_tree.hpp"
+#include "file_header.hpp"
+#include "histogram.hpp"
+#include "adaptive_encoder.hpp"
+
+
+/**
+ * @brief helper class giving access to the whole file of a descriptor, the descriptor is not closed
+ *
+ * The file can change while the request is served, since the client still holds it. A mapping of a file which is
+ * truncated would raise SIGBUS in the server, so only shared memory files sealed against shrinking and writing are
+ * mapped, and other files are read into a buffer of the thread.
+ *
+ */
+class DescriptorInput{
+    public:
+        const char *data = nullptr;
+        size_t size = 0;
+        bool ok = false;
+
+        /**
+         * @brief Construct a new Descriptor Input object
+         *
+         * @param fd descriptor of the file, must be a regular file or a sealed shared memory file
+         * @param buffer buffer the file is read into if it is not mapped
+         */
+        DescriptorInput(int fd, std::vector<char> &buffer){
+            struct stat st;
+            if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+                return;
+            }
+            size = st.st_size;
+            // only shared memory files have seals, the others fail with EINVAL
+            int seals = fcntl(fd, F_GET_SEALS);
+            if(seals >= 0){
+                if((seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE)){
+                    return;
+                }
+                // empty files cannot be mapped
+                if(size > 0){
+                    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+                    if(mapping == MAP_FAILED){
+                        return;
+                    }
+                    madvise(mapping, size, MADV_SEQUENTIAL);
+                    mapped = true;
+                    data = static_cast<const char *>(mapping);
+                }
+                ok = true;
+                return;
+            }
+            buffer.resize(size);
+            size_t done = 0;
+            while(done < size){
+                ssize_t ret = pread(fd, buffer.data() + done, size - done, done);
+                if(ret < 0 && errno == EINTR){
+                    continue;
+                }
+                // a file shrinking while it is read is an error
+                if(ret <= 0){
+                    return;
+                }
+                done += ret;
+            }
+            data = buffer.data();
+            ok = true;
+        }
+        ~DescriptorInput(){
+            if(mapped){
+                munmap(const_cast<char *>(data), size);
+            }
+        }
+        DescriptorInput(const DescriptorInput &) = delete;
+        DescriptorInput &operator=(const DescriptorInput &) = delete;
+
+    private:
+        bool mapped = false;
+};
+
+/**
+ * @brief helper function writing a buffer at a position of a file, retrying after partial writes
+ *
+ * @param fd descriptor of the file
+ * @param buffer buffer containing the bytes to write
+ * @param size number of bytes to write
+ * @param offset position of the file to write at
+ * @return true if all the bytes were written
+ * @return false otherwise
+ */
+static bool write_at(int fd, const char *buffer, size_t size, uint64_t offset){
+    size_t done = 0;
+    while(done < size){
+        ssize_t ret = pwrite(fd, buffer + done, size - done, offset + done);
+        if(ret < 0 && errno == EINTR){
+            continue;
+        }
+        if(ret <= 0){
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
+
+/**
+ * @brief Construct a new Huffman Service:: Huffman Service object
+ *
+ * @param n_threads number of threads serving requests, each one gets its own buffers
+ * @param max_length maximum length of the codes, 0 if not limited
+ */
+HuffmanService::HuffmanService(int n_threads, int max_length){
+    this->max_length = max_length;
+    buffers.resize(n_threads);
+    input_buffers.resize(n_threads);
+    tables.reserve(CACHE_SIZE);
+}
+
+/**
+ * @brief getter method for the number of requests which found their table in the cache
+ *
+ * @return long
+ */
+long HuffmanService::getTableHits(){return table_hits;}
+/**
+ * @brief getter method for the number of requests which built their table
+ *
+ * @return long
+ */
+long HuffmanService::getTableMisses(){return table_misses;}
+
+/**
+ * @brief method adding a table to the cache, replacing the least recently used one if the cache is full.
+ * Must be called holding the lock of the cache
+ *
+ * @param codes table of encodings, the lengths are taken from it
+ * @return cached_table& the entry of the table
+ */
+HuffmanService::cached_table &HuffmanService::insert_table(const std::vector<std::pair<int, int>> &codes){
+    cached_table *entry;
+    if(tables.size() < CACHE_SIZE){
+        entry = &tables.emplace_back();
+    }
+    else{
+        entry = &*std::min_element(tables.begin(), tables.end(),
+                                    [](const cached_table &a, const cached_table &b){return a.last_use < b.last_use;});
+    }
+    entry->codes = codes;
+    entry->code_lengths.assign(codes.size(), 0);
+    for(int i=0; i<codes.size(); i++){
+        entry->code_lengths[i] = codes[i].first;
+    }
+    entry->canonical = codes == HuffmanTree::canonicalCodes(entry->code_lengths);
+    entry->writer = nullptr;
+    entry->decoder = nullptr;
+    entry->last_use = use_clock++;
+    return *entry;
+}
+
+/**
+ * @brief method choosing the table to encode a payload with, from the cache if one is close enough to the best
+ *
+ * @param char_counts frequencies of the characters of the payload
+ * @param code_lengths where to store the lengths of the codes chosen
+ * @return std::shared_ptr<BitWriter> object encoding with the chosen codes
+ */
+std::shared_ptr<BitWriter> HuffmanService::encoding_table(const std::vector<uint64_t> &char_counts, std::vector<int> &code_lengths){
+    uint64_t n_chars = 0;
+    double entropy = 0;
+    for(auto &c : char_counts){
+        n_chars += c;
+    }
+    for(auto &c : char_counts){
+        if(c > 0){
+            entropy += c * std::log2(double(n_chars) / c);
+        }
+    }
+
+    // finds the cheapest cached table which can encode the payload, only canonical codes are written to the header
+    auto cheapest = [&](uint64_t &best_bits){
+        cached_table *best = nullptr;
+        for(auto &table : tables){
+            uint64_t n_bits;
+            bool usable = table.canonical
+                            && (max_length == 0 || *std::max_element(table.code_lengths.begin(), table.code_lengths.end()) <= max_length);
+            if(usable && HuffmanTree::tableBits(char_counts, table.code_lengths, n_bits) && (best == nullptr || n_bits < best_bits)){
+                best = &table;
+                best_bits = n_bits;
+            }
+        }
+        return best;
+    };
+    auto use = [&](cached_table &table){
+        table.last_use = use_clock++;
+        if(table.writer == nullptr){
+            table.writer = std::make_shared<BitWriter>(table.codes);
+        }
+        code_lengths = table.code_lengths;
+        return table.writer;
+    };
+
+    // no code can do better than the entropy, so the codes of the payload are not needed to accept a close table
+    {
+        std::lock_guard lk(cache_m);
+        uint64_t best_bits;
+        cached_table *best = cheapest(best_bits);
+        if(best != nullptr && best_bits * 100 <= entropy * (100 + AdaptiveEncoder::REUSE_TOLERANCE)){
+            table_hits++;
+            return use(*best);
+        }
+    }
+
+    HuffmanTree ht(char_counts, max_length);
+    std::vector<int> own_lengths = ht.getCodeLengths();
+    uint64_t own_bits;
+    HuffmanTree::tableBits(char_counts, own_lengths, own_bits);
+
+    std::lock_guard lk(cache_m);
+    uint64_t best_bits;
+    cached_table *best = cheapest(best_bits);
+    if(best != nullptr && best_bits * 100 <= own_bits * (100 + AdaptiveEncoder::REUSE_TOLERANCE)){
+        table_hits++;
+        return use(*best);
+    }
+    table_misses++;
+    return use(insert_table(HuffmanTree::canonicalCodes(own_lengths)));
+}
+
+/**
+ * @brief method returning the decoder of a table of codes, from the cache if it was already built
+ *
+ * @param codes table of encodings
+ * @return std::shared_ptr<HuffmanDecoder> decoder of the table
+ */
+std::shared_ptr<HuffmanDecoder> HuffmanService::decoding_table(const std::vector<std::pair<int, int>> &codes){
+    auto find = [&](){
+        auto it = std::find_if(tables.begin(), tables.end(), [&](const cached_table &table){return table.codes == codes;});
+        return it == tables.end() ? nullptr : &*it;
+    };
+    {
+        std::lock_guard lk(cache_m);
+        cached_table *table = find();
+        if(table != nullptr && table->decoder != nullptr){
+            table->last_use = use_clock++;
+            table_hits++;
+            return table->decoder;
+        }
+    }
+
+    // the decoder is built without holding the lock, another thread may have built the same one meanwhile
+    auto decoder = std::make_shared<HuffmanDecoder>(codes);
+    std::lock_guard lk(cache_m);
+    cached_table *table = find();
+    if(table == nullptr){
+        table = &insert_table(codes);
+    }
+    if(table->decoder == nullptr){
+        table->decoder = decoder;
+    }
+    table->last_use = use_clock++;
+    table_misses++;
+    return table->decoder;
+}
+
+/**
+ * @brief method encoding a file, writing the encoded file at the start of the output
+ *
+ * All the chunks use the same table, which is stored in the first one which is encoded. Chunks which would not
+ * shrink are stored raw.
+ *
+ * @param input_fd descriptor of the file to encode, must be a regular file or a shared memory file sealed against
+ * shrinking and writing
+ * @param output_fd descriptor to write the encoded file to, must support positional writes
+ * @param tid index of the thread serving the request
+ * @param input_size where to store the size of the input
+ * @param output_size where to store the size of the encoded file
+ * @return int32_t status of the request
+ */
+int32_t HuffmanService::compress(int input_fd, int output_fd, int tid, uint64_t &input_size, uint64_t &output_size){
+    input_size = 0;
+    output_size = 0;
+    DescriptorInput input(input_fd, input_buffers[tid]);
+    if(!input.ok){
+        return INPUT_ERROR;
+    }
+    input_size = input.size;
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(input.data);
+
+    uint64_t chunk_chars = FileHeader::DEFAULT_CHUNK_CHARS;
+    int n_chunks = std::max(uint64_t(1), (input_size + chunk_chars - 1) / chunk_chars);
+    std::vector<std::vector<uint64_t>> chunk_counts(n_chunks, std::vector<uint64_t>(256, 0));
+    std::vector<uint64_t> char_counts(256, 0);
+    for(int i=0; i<n_chunks; i++){
+        count_bytes(data + i * chunk_chars, std::min(chunk_chars, input_size - i * chunk_chars), chunk_counts[i]);
+        for(int c=0; c<256; c++){
+            char_counts[c] += chunk_counts[i][c];
+        }
+    }
+    std::vector<int> code_lengths;
+    auto writer = encoding_table(char_counts, code_lengths);
+
+    FileHeader header(n_chunks, input_size, chunk_chars);
+    auto file_header = header.serialize();
+    uint64_t table_bits = 8 * (header.serializeChunk(0, 0, &code_lengths).size() - header.serializeChunk(0, 0).size());
+    bool table_written = false;
+    auto &buffer = buffers[tid];
+    uint64_t offset = 0;
+    for(int i=0; i<n_chunks; i++){
+        const unsigned char *chunk = data + i * chunk_chars;
+        uint64_t size = std::min(chunk_chars, input_size - i * chunk_chars);
+        uint64_t n_bits;
+        HuffmanTree::tableBits(chunk_counts[i], code_lengths, n_bits);
+        bool raw = header.storeRaw(n_bits + (table_written ? 0 : table_bits), size);
+        bool own_table = !raw && !table_written;
+        table_written |= own_table;
+        uint64_t chunk_size = raw ? size : BitWriter::byte_size(n_bits);
+        // the first chunk is written along with the header of the file
+        size_t start = i == 0 ? file_header.size() : 0;
+        auto chunk_header = header.serializeChunk(chunk_size, raw ? FileHeader::RAW_CHUNK : BitWriter::padding(n_bits),
+                                                    own_table ? &code_lengths : nullptr);
+        buffer.resize(start + chunk_header.size() + (raw ? size : BitWriter::buffer_size(n_bits)));
+        std::copy(file_header.begin(), file_header.begin() + start, buffer.begin());
+        std::copy(chunk_header.begin(), chunk_header.end(), buffer.begin() + start);
+        if(raw){
+            std::copy(chunk, chunk + size, buffer.begin() + start + chunk_header.size());
+        }
+        else{
+            writer->encode(chunk, size, buffer.data() + start + chunk_header.size());
+        }
+        size_t length = start + chunk_header.size() + chunk_size;
+        if(!write_at(output_fd, buffer.data(), length, offset)){
+            return OUTPUT_ERROR;
+        }
+        offset += length;
+    }
+    output_size = offset;
+    return OK;
+}
+
+/**
+ * @brief method decoding a file encoded by any of the encoders, writing the decoded file at the start of the output
+ *
+ * @param input_fd descriptor of the encoded file, must be a regular file or a shared memory file sealed against
+ * shrinking and writing
+ * @param output_fd descriptor to write the decoded file to, must support positional writes
+ * @param tid index of the thread serving the request
+ * @param input_size where to store the size of the encoded file
+ * @param output_size where to store the size of the decoded file
+ * @return int32_t status of the request
+ */
+int32_t HuffmanService::decompress(int input_fd, int output_fd, int tid, uint64_t &input_size, uint64_t &output_size){
+    input_size = 0;
+    output_size = 0;
+    DescriptorInput input(input_fd, input_buffers[tid]);
+    if(!input.ok){
+        return INPUT_ERROR;
+    }
+    input_size = input.size;
+
+    FileHeader header;
+    size_t pos = header.parse(input.data, input.size);
+    if(pos == 0){
+        return CORRUPTED;
+    }
+    bool adaptive = header.getVersion() >= FileHeader::ADAPTIVE;
+    bool stream = header.getVersion() == FileHeader::STREAM;
+    std::shared_ptr<HuffmanDecoder> decoder;
+    if(!adaptive && header.getNChars() > 0){
+        decoder = decoding_table(header.getCodes());
+    }
+
+    // chunks are decoded in order as their headers are read, see hc_decode for the layout of each version
+    auto &buffer = buffers[tid];
+    uint64_t offset = 0;
+    for(int i=0; stream || i<header.getNChunks(); i++){
+        uint64_t chunk_size;
+        char padding;
+        std::vector<int> code_lengths;
+        uint64_t chunk_chars;
+        size_t chunk_header = header.parseChunk(input.data + pos, input.size - pos, i, chunk_size, padding, &code_lengths, &chunk_chars);
+        if(stream && chunk_header != 0 && chunk_chars == 0){
+            break;
+        }
+        // chunks must fit in the input and hold their characters, see parseChunk
+        bool raw = padding == FileHeader::RAW_CHUNK;
+        uint64_t n_chars = chunk_chars;
+        if(chunk_header == 0
+                || (adaptive && !raw && decoder == nullptr && code_lengths.empty())
+                || !header.verifyChunk(input.data + pos, chunk_header, input.data + pos + chunk_header, chunk_size)){
+            return CORRUPTED;
+        }
+        if(!code_lengths.empty()){
+            decoder = decoding_table(HuffmanTree::canonicalCodes(code_lengths));
+        }
+        pos += chunk_header;
+        // raw chunks are written directly from the mapping of the input
+        const char *output = input.data + pos;
+        if(!raw){
+            buffer.resize(n_chars);
+            output = buffer.data();
+        }
+        if(!raw && n_chars > 0){
+            uint64_t bits = decoder->decode(input.data + pos, chunk_size, reinterpret_cast<unsigned char *>(buffer.data()), n_chars);
+            if(chunk_size > 0 && bits != chunk_size * 8 - padding){
+                return CORRUPTED;
+            }
+        }
+        if(!write_at(output_fd, output, n_chars, offset)){
+            return OUTPUT_ERROR;
+        }
+        pos += chunk_size;
+        offset += n_chars;
+    }
+    output_size = offset;
+    return OK;
+}
+
+/**
+ * @brief function sending a message on a socket, along with some descriptors
+ *
+ * @param sock descriptor of the connected socket
+ * @param message buffer containing the message
+ * @param size size of the message
+ * @param fds descriptors to pass, can be nullptr if n_fds is 0
+ * @param n_fds number of descriptors to pass
+ * @return true if the whole message was sent
+ * @return false otherwise
+ */
+bool HuffmanService::send_message(int sock, const void *message, size_t size, const int *fds, int n_fds){
+    iovec iov = {const_cast<void *>(message), size};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    std::vector<char> control;
+    if(n_fds > 0){
+        control.resize(CMSG_SPACE(n_fds * sizeof(int)));
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(n_fds * sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), fds, n_fds * sizeof(int));
+    }
+    ssize_t ret;
+    do{
+        // a closed peer must not kill the process with SIGPIPE
+        ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while(ret < 0 && errno == EINTR);
+    return ret == ssize_t(size);
+}
+
+/**
+ * @brief function receiving a message from a socket, along with the descriptors passed with it
+ *
+ * Descriptors beyond max_fds are closed.
+ *
+ * @param sock descriptor of the connected socket
+ * @param message buffer to store the message in
+ * @param size size of the buffer
+ * @param fds where to store the descriptors received
+ * @param max_fds maximum number of descriptors to store
+ * @param n_fds where to store the number of descriptors received
+ * @return ssize_t size of the message, 0 if the peer closed the connection, -1 on errors
+ */
+ssize_t HuffmanService::receive_message(int sock, void *message, size_t size, int *fds, int max_fds, int &n_fds){
+    iovec iov = {message, size};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    // room for a few more descriptors than expected, so that extra ones can be closed
+    std::vector<char> control(CMSG_SPACE((max_fds + 4) * sizeof(int)));
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    n_fds = 0;
+    ssize_t ret;
+    do{
+        ret = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while(ret < 0 && errno == EINTR);
+    if(ret < 0){
+        return ret;
+    }
+    for(cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS){
+            continue;
+        }
+        int count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(int i=0; i<count; i++){
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if(n_fds < max_fds){
+                fds[n_fds++] = fd;
+            }
+            else{
+                close(fd);
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief function computing a percentile of a set of samples with the nearest rank method
+ *
+ * @param samples samples to compute the percentile of, sorted by the function
+ * @param p percentile to compute, between 0 and 100
+ * @return long the percentile, 0 if there are no samples
+ */
+long HuffmanService::percentile(std::vector<long> &samples, double p){
+    if(samples.empty()){
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t rank = std::ceil(p / 100 * samples.size());
+    return samples[std::clamp(rank, size_t(1), samples.size()) - 1];
+}
+
+/**
+ * @brief function describing the status of a reply
+ *
+ * @param status status of the reply
+ * @return std::string description of the status
+ */
+std::string HuffmanService::status_string(int32_t status){
+    switch(status){
+    case OK:
+        return "ok";
+    case BAD_REQUEST:
+        return "bad request";
+    case INPUT_ERROR:
+        return "input cannot be mapped";
+    case CORRUPTED:
+        return "input is not a valid encoded file";
+    case OUTPUT_ERROR:
+        return "output cannot be written";
+    default:
+        return "unknown status";
+    }
+}
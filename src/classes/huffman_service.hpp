@@ -0,0 +1,156 @@
+/**
+ * @file huffman_service.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class serving compression and decompression requests of a long running process
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "bit_writer.hpp"
+#include "huffman_decoder.hpp"
+
+
+/**
+ * @brief type of the requests sent by the clients, passed along with the descriptors of the input and of the output
+ *
+ */
+typedef struct{
+    uint32_t op;
+    uint32_t reserved;
+    uint64_t id;
+} service_request;
+
+/**
+ * @brief type of the replies sent by the server, one for each request
+ *
+ */
+typedef struct{
+    uint32_t op;
+    int32_t status;
+    uint64_t id;
+    uint64_t input_size;
+    uint64_t output_size;
+    uint64_t service_time;
+} service_reply;
+
+/**
+ * @brief class encoding and decoding files passed by descriptor, keeping the tables of codes between requests
+ *
+ * Clients pass the descriptors of their input and output over a Unix domain socket, so the data is never copied
+ * through the socket: the input is read into a buffer of the thread, or mapped in memory when it is a shared memory
+ * file created by the client and sealed against shrinking and writing.
+ * Encoded files use the adaptive header with chunks of FileHeader::DEFAULT_CHUNK_CHARS characters, so that the
+ * decoder of the other programs can read them, and all the versions of the header can be decoded.
+ * The tables of the last requests are cached, along with their encoding and decoding tables. A payload reuses a
+ * cached table when it costs at most AdaptiveEncoder::REUSE_TOLERANCE percent more than its own codes, which are not
+ * built at all when the cached table is that close to the entropy of the payload.
+ * Each request is served by a single thread, with buffers kept for the next requests of the same thread.
+ *
+ */
+class HuffmanService{
+    private:
+        /**
+         * @brief type storing a table of codes in the cache, the encoder and the decoder are built when first needed
+         *
+         */
+        typedef struct{
+            std::vector<int> code_lengths;
+            std::vector<std::pair<int, int>> codes;
+            bool canonical;
+            std::shared_ptr<BitWriter> writer;
+            std::shared_ptr<HuffmanDecoder> decoder;
+            uint64_t last_use;
+        } cached_table;
+
+        /**
+         * @brief maximum length of the codes, 0 if not limited
+         *
+         */
+        int max_length;
+        /**
+         * @brief cached tables, the least recently used is replaced when the cache is full
+         *
+         */
+        std::vector<cached_table> tables;
+        /**
+         * @brief counter ordering the uses of the cached tables
+         *
+         */
+        uint64_t use_clock = 0;
+        /**
+         * @brief lock protecting the cache
+         *
+         */
+        std::mutex cache_m;
+        /**
+         * @brief buffers of each thread, reused between requests
+         *
+         */
+        std::vector<std::vector<char>> buffers;
+        /**
+         * @brief buffers of each thread the inputs which are not mapped are read into, reused between requests
+         *
+         */
+        std::vector<std::vector<char>> input_buffers;
+        /**
+         * @brief number of tables found in the cache
+         *
+         */
+        std::atomic<long> table_hits = 0;
+        /**
+         * @brief number of tables built
+         *
+         */
+        std::atomic<long> table_misses = 0;
+
+        std::shared_ptr<BitWriter> encoding_table(const std::vector<uint64_t> &char_counts, std::vector<int> &code_lengths);
+        std::shared_ptr<HuffmanDecoder> decoding_table(const std::vector<std::pair<int, int>> &codes);
+        cached_table &insert_table(const std::vector<std::pair<int, int>> &codes);
+
+    public:
+        /**
+         * @brief socket the server listens on if no other is given
+         *
+         */
+        static constexpr const char *DEFAULT_SOCKET = "/tmp/hc_server.sock";
+        /**
+         * @brief number of tables kept in the cache
+         *
+         */
+        static const int CACHE_SIZE = 64;
+
+        // operations of the requests
+        static const uint32_t COMPRESS = 1;
+        static const uint32_t DECOMPRESS = 2;
+        static const uint32_t SHUTDOWN = 3;
+
+        // status of the replies
+        static const int32_t OK = 0;
+        static const int32_t BAD_REQUEST = 1;
+        static const int32_t INPUT_ERROR = 2;
+        static const int32_t CORRUPTED = 3;
+        static const int32_t OUTPUT_ERROR = 4;
+
+        HuffmanService(int n_threads, int max_length = 0);
+
+        long getTableHits();
+        long getTableMisses();
+
+        int32_t compress(int input_fd, int output_fd, int tid, uint64_t &input_size, uint64_t &output_size);
+        int32_t decompress(int input_fd, int output_fd, int tid, uint64_t &input_size, uint64_t &output_size);
+
+        static bool send_message(int sock, const void *message, size_t size, const int *fds = nullptr, int n_fds = 0);
+        static ssize_t receive_message(int sock, void *message, size_t size, int *fds, int max_fds, int &n_fds);
+        static long percentile(std::vector<long> &samples, double p);
+        static std::string status_string(int32_t status);
+};
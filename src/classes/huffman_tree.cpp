@@ -9,6 +9,9 @@
 #include "huffman_tree.hpp"
 #include <queue>
 #include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
 
 //Huffman node implementation
 
@@ -18,7 +21,7 @@
  * @param init_ch character to store in the node
  * @param init_frequency frequency to store in the node
  */
-HuffmanNode::HuffmanNode(unsigned char init_ch, int init_frequency){
+HuffmanNode::HuffmanNode(unsigned char init_ch, uint64_t init_frequency){
         ch = init_ch;
         frequency = init_frequency;
     }
@@ -32,9 +35,9 @@ unsigned char HuffmanNode::getCh(){return ch;}
 /**
  * @brief getter method for frequency stored
  * 
- * @return int 
+ * @return uint64_t 
  */
-int HuffmanNode::getFrequency(){return frequency;}
+uint64_t HuffmanNode::getFrequency(){return frequency;}
 /**
  * @brief getter method for pointer to left child
  * 
@@ -125,6 +128,103 @@ std::shared_ptr<HuffmanNode> HuffmanTree::getRoot(){return root;}
  * @return std::vector<std::pair<int, int>> 
  */
 std::vector<std::pair<int, int>> HuffmanTree::getCodes(){return code_table;}
+/**
+ * @brief getter method for the lengths of the encodings
+ * 
+ * @return std::vector<int> length of the encoding of each character, 0 if the character is absent
+ */
+std::vector<int> HuffmanTree::getCodeLengths(){
+    std::vector<int> code_lengths(code_table.size());
+    for(int i=0; i<code_table.size(); i++){
+        code_lengths[i] = code_table[i].first;
+    }
+    return code_lengths;
+}
+/**
+ * @brief getter method for the canonical table of encodings
+ * 
+ * The canonical codes have the same lengths as the ones extracted from the tree, so the size of the
+ * encoding does not change, but can be rebuilt from the lengths alone.
+ * 
+ * @return std::vector<std::pair<int, int>> 
+ */
+std::vector<std::pair<int, int>> HuffmanTree::getCanonicalCodes(){return canonicalCodes(getCodeLengths());}
+
+/**
+ * @brief method computing the canonical table of encodings from the lengths of the codes
+ * 
+ * Characters are sorted by length of the code and then by value. The first one gets a code made of zeros
+ * and each of the following gets the code of the previous one increased by 1 and shifted left to match its length.
+ * 
+ * @param code_lengths length of the encoding of each character, 0 if the character is absent
+ * @return std::vector<std::pair<int, int>> table of encodings in the same form as getCodes
+ */
+std::vector<std::pair<int, int>> HuffmanTree::canonicalCodes(const std::vector<int> &code_lengths){
+    std::vector<std::pair<int, int>> codes(code_lengths.size(), std::make_pair(0, 0));
+    std::vector<int> order;
+    for(int i=0; i<code_lengths.size(); i++){
+        if(code_lengths[i] != 0){
+            order.push_back(i);
+        }
+    }
+    // stable sort keeps characters with the same length ordered by value
+    std::stable_sort(order.begin(), order.end(), [&code_lengths](int a, int b)
+        {return code_lengths[a] < code_lengths[b];});
+
+    // a code of 32 bits may be shifted by 32 positions, which a 32 bit integer cannot do
+    uint64_t code = 0;
+    int length = 0;
+    for(auto &ch : order){
+        code <<= (code_lengths[ch] - length);
+        length = code_lengths[ch];
+        codes[ch] = std::make_pair(length, int(code));
+        code++;
+    }
+    return codes;
+}
+
+/**
+ * @brief method computing the number of bits needed to encode some characters with the given codes
+ * 
+ * Used to choose between tables of codes built from different frequencies.
+ * 
+ * @param char_counts frequencies of the characters to encode
+ * @param code_lengths lengths of the codes of the characters, 0 if the character has no code
+ * @param n_bits where to store the number of bits of the encoding
+ * @return true if all the characters have a code
+ * @return false otherwise
+ */
+bool HuffmanTree::tableBits(const std::vector<uint64_t> &char_counts, const std::vector<int> &code_lengths, uint64_t &n_bits){
+    n_bits = 0;
+    if(code_lengths.size() < char_counts.size()){
+        return false;
+    }
+    for(int i=0; i<char_counts.size(); i++){
+        if(char_counts[i] != 0 && code_lengths[i] == 0){
+            return false;
+        }
+        n_bits += char_counts[i] * code_lengths[i];
+    }
+    return true;
+}
+
+/**
+ * @brief helper recursive function to extract the lengths of the encodings
+ * 
+ * The tree can be deeper than the bits of a code, so only the depth of each leaf is computed before the
+ * lengths are checked against the maximum length, see extract_codes_rec.
+ * 
+ * @param huffman_tree pointer to subtree currently being computed
+ * @param length depth of the subtree
+ */
+void HuffmanTree::extract_lengths_rec(std::shared_ptr<HuffmanNode> huffman_tree, int length){
+    if(huffman_tree->getLeftChild()==nullptr && huffman_tree->getRightChild()==nullptr){
+        code_table[int(huffman_tree->getCh())] = std::make_pair(length, 0);
+        return;
+    }
+    extract_lengths_rec(huffman_tree->getLeftChild(), length+1);
+    extract_lengths_rec(huffman_tree->getRightChild(), length+1);
+}
 
 /**
  * @brief helper recursive function to extract the table of encodings
@@ -132,16 +232,17 @@ std::vector<std::pair<int, int>> HuffmanTree::getCodes(){return code_table;}
  * At each call takes the code and bitshifts it left. To the left child it is passed as is, to the right child is increased by 1.
  * Length is increased by 1 in both cases, keeping track of the number of parent nodes traversed to reach the current node.
  * When a leaf is reached the code is saved inside the object containing the code table.
+ * Only called once the tree is known not to be deeper than MAX_CODE_LENGTH.
  * 
  * @param huffman_tree pointer to subtree currently being computed
  * @param code the current encoding
  * @param length the lenght (releavant bits) of the current encoding
  */
-void HuffmanTree::extract_codes_rec(std::shared_ptr<HuffmanNode> huffman_tree, int code, int length){
+void HuffmanTree::extract_codes_rec(std::shared_ptr<HuffmanNode> huffman_tree, uint64_t code, int length){
 
     // base case, a node has no children
     if(huffman_tree->getLeftChild()==nullptr && huffman_tree->getRightChild()==nullptr){
-        code_table[int(huffman_tree->getCh())] = std::make_pair(length, code);
+        code_table[int(huffman_tree->getCh())] = std::make_pair(length, int(code));
         return;
     }
 
@@ -155,14 +256,150 @@ void HuffmanTree::extract_codes_rec(std::shared_ptr<HuffmanNode> huffman_tree, i
 }
 
 
+/**
+ * @brief method computing the size of the encoding from the frequencies of the characters
+ * 
+ * @param char_counts vector containing the frequencies of the characters
+ * @return uint64_t number of bits of the encoding
+ */
+uint64_t HuffmanTree::encodedBits(const std::vector<uint64_t> &char_counts){
+    uint64_t n_bits = 0;
+    for(int i=0; i<char_counts.size() && i<code_table.size(); i++){
+        n_bits += char_counts[i] * code_table[i].first;
+    }
+    return n_bits;
+}
+
+/**
+ * @brief getter method for the size of the encoding of the characters the tree was built from, with the codes
+ * of the Huffman tree before limiting their length
+ * 
+ * @return uint64_t number of bits of the encoding
+ */
+uint64_t HuffmanTree::getUnlimitedBits(){return unlimited_bits;}
+
+/**
+ * @brief getter method for the maximum length of the codes, the one asked for unless n characters need codes
+ * of log2(n) bits
+ * 
+ * @return int
+ */
+int HuffmanTree::getMaxLength(){return max_length;}
+
+/**
+ * @brief helper function computing optimal code lengths not longer than a given maximum
+ * 
+ * Implements the package-merge algorithm: starting from the list of characters sorted by frequency, at each step
+ * adjacent items of the list are paired into packages, which are then merged with the characters again.
+ * After max_length-1 steps, the length of the code of each character is the number of times it appears in the
+ * first 2n-2 items of the list, where n is the number of characters.
+ * Items are stored as nodes of a forest, so that the characters contained in a package can be retrieved.
+ * 
+ * @param char_counts vector containing the frequencies of the characters
+ * @param max_length maximum length of the codes, at least log2 of the number of characters
+ * @return std::vector<int> length of the code of each character, 0 if the character is absent
+ */
+std::vector<int> HuffmanTree::package_merge(std::vector<uint64_t> &char_counts, int max_length){
+    // node of the forest, leaves have no children and store the character
+    typedef struct{
+        uint64_t weight;
+        int left;
+        int right;
+        int ch;
+    } pm_node;
+
+    std::vector<pm_node> nodes;
+    std::vector<int> leaves;
+    for(int i=0; i<char_counts.size(); i++){
+        if(char_counts[i] != 0){
+            leaves.push_back(nodes.size());
+            nodes.push_back({char_counts[i], -1, -1, i});
+        }
+    }
+    std::stable_sort(leaves.begin(), leaves.end(), [&nodes](int a, int b){return nodes[a].weight < nodes[b].weight;});
+
+    std::vector<int> items = leaves;
+    for(int level=1; level<max_length; level++){
+        // pair adjacent items into packages
+        std::vector<int> packages;
+        for(int i=0; i+1<items.size(); i+=2){
+            packages.push_back(nodes.size());
+            nodes.push_back({nodes[items[i]].weight + nodes[items[i+1]].weight, items[i], items[i+1], -1});
+        }
+        // merge packages with the characters, both are already sorted
+        items.clear();
+        std::merge(leaves.begin(), leaves.end(), packages.begin(), packages.end(), std::back_inserter(items),
+                    [&nodes](int a, int b){return nodes[a].weight < nodes[b].weight;});
+    }
+
+    // count the occurrences of each character in the selected items
+    std::vector<int> code_lengths(char_counts.size(), 0);
+    std::vector<int> stack;
+    for(int i=0; i<2*int(leaves.size())-2 && i<items.size(); i++){
+        stack.push_back(items[i]);
+        while(!stack.empty()){
+            auto &node = nodes[stack.back()];
+            stack.pop_back();
+            if(node.left == -1){
+                code_lengths[node.ch]++;
+            }
+            else{
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+    }
+    return code_lengths;
+}
+
+/**
+ * @brief helper recursive function building the tree from the canonical codes
+ * 
+ * Characters in the range share the first depth bits of their codes, the range is split between the
+ * characters with a 0 and the ones with a 1 in the next bit.
+ * 
+ * @param chars characters sorted by their canonical code
+ * @param char_counts vector containing the frequencies of the characters
+ * @param first first character of the range
+ * @param last character past the end of the range
+ * @param depth number of bits shared by the codes in the range
+ * @return std::shared_ptr<HuffmanNode> root of the subtree
+ */
+std::shared_ptr<HuffmanNode> HuffmanTree::build_from_codes_rec(std::vector<int> &chars, std::vector<uint64_t> &char_counts,
+                                                                int first, int last, int depth){
+    if(last - first == 1 && code_table[chars[first]].first == depth){
+        return std::shared_ptr<HuffmanNode>(new HuffmanNode(chars[first], char_counts[chars[first]]));
+    }
+    // first character having a 1 in the bit following the shared ones
+    int middle = first;
+    while(middle < last){
+        auto code = code_table[chars[middle]];
+        if((uint32_t(code.second) >> (code.first - depth - 1)) & 1){
+            break;
+        }
+        middle++;
+    }
+    auto left = build_from_codes_rec(chars, char_counts, first, middle, depth+1);
+    auto right = build_from_codes_rec(chars, char_counts, middle, last, depth+1);
+
+    std::shared_ptr<HuffmanNode> node(new HuffmanNode(0, left->getFrequency()+right->getFrequency()));
+    node->setLeftChild(left);
+    node->setRightChild(right);
+    return node;
+}
+
 /**
  * @brief Construct a new Huffman Tree:: Huffman Tree object
  * 
- * Creates the huffman tree and extracts the corresponding table of encodings from it
+ * Creates the huffman tree and extracts the corresponding table of encodings from it.
+ * If the codes exceed the maximum length, the lengths are recomputed with package-merge and both the tree
+ * and the table of encodings are replaced by the canonical ones. Codes are always limited to MAX_CODE_LENGTH.
  * 
  * @param char_counts vector containing the frequencies of the characters
+ * @param max_length maximum length of the codes, 0 for no limit other than MAX_CODE_LENGTH.
+ * Raised to log2 of the number of characters if smaller, see getMaxLength
  */
-HuffmanTree::HuffmanTree(std::vector<int> char_counts){
+HuffmanTree::HuffmanTree(std::vector<uint64_t> char_counts, int max_length){
     // vector containing the leaves of the tree
     std::vector<std::shared_ptr<HuffmanNode>> ht_leaves;
     for(int i=0; i<char_counts.size(); i++){
@@ -170,6 +407,16 @@ HuffmanTree::HuffmanTree(std::vector<int> char_counts){
             ht_leaves.push_back(std::shared_ptr<HuffmanNode>(new HuffmanNode(i, char_counts[i])));
         }
     }
+
+    // n characters cannot have codes shorter than log2(n) bits
+    if(max_length <= 0 || max_length > MAX_CODE_LENGTH){
+        max_length = MAX_CODE_LENGTH;
+    }
+    int n_chars = ht_leaves.size();
+    while((uint64_t(1) << max_length) < n_chars){
+        max_length++;
+    }
+    this->max_length = max_length;
     // sort the leaves by frequency, necessary for creating the huffman tree
     auto compare_node = [](std::shared_ptr<HuffmanNode> n1, std::shared_ptr<HuffmanNode> n2) 
         {return n1->getFrequency() < n2->getFrequency();};
@@ -231,6 +478,12 @@ HuffmanTree::HuffmanTree(std::vector<int> char_counts){
         comp_queue.push(new_node);
     }
 
+    // no characters, the tree is empty
+    if(leaf_queue.empty() && comp_queue.empty()){
+        root = nullptr;
+        return;
+    }
+
     if(comp_queue.empty()){
         root = leaf_queue.front();
     }
@@ -238,7 +491,87 @@ HuffmanTree::HuffmanTree(std::vector<int> char_counts){
         root = comp_queue.front();
     }
 
-    //calls to the function extracting the table of encodings
-    extract_codes_rec(root->getLeftChild(), 0, 1);
-    extract_codes_rec(root->getRightChild(), 1, 1);
-}
\ No newline at end of file
+    // a single character still needs one bit to be encoded
+    if(root->getLeftChild()==nullptr){
+        code_table[int(root->getCh())] = std::make_pair(1, 0);
+        unlimited_bits = root->getFrequency();
+        return;
+    }
+
+    // only the lengths are extracted first, the codes of a tree deeper than MAX_CODE_LENGTH do not fit in an integer
+    extract_lengths_rec(root, 0);
+    unlimited_bits = encodedBits(char_counts);
+
+    // check if codes are too long
+    int longest = 0;
+    for(auto &c : code_table){
+        longest = std::max(longest, c.first);
+    }
+    if(longest <= max_length){
+        //calls to the function extracting the table of encodings
+        extract_codes_rec(root->getLeftChild(), 0, 1);
+        extract_codes_rec(root->getRightChild(), 1, 1);
+        return;
+    }
+
+    // replace codes with the length limited canonical ones, and rebuild the tree from them
+    code_table = canonicalCodes(package_merge(char_counts, max_length));
+    std::vector<int> chars;
+    for(int i=0; i<code_table.size(); i++){
+        if(code_table[i].first != 0){
+            chars.push_back(i);
+        }
+    }
+    std::stable_sort(chars.begin(), chars.end(), [this](int a, int b){return code_table[a].first < code_table[b].first;});
+    root = build_from_codes_rec(chars, char_counts, 0, chars.size(), 0);
+}
+
+
+//Length limit report implementation
+
+/**
+ * @brief method adding a tree to the report
+ * 
+ * @param ht tree built with a limit on the length of the codes
+ * @param char_counts vector containing the frequencies of the characters the tree was built from
+ */
+void LengthLimitReport::add(HuffmanTree &ht, const std::vector<uint64_t> &char_counts){
+    uint64_t bits = ht.encodedBits(char_counts);
+    std::lock_guard lk(m);
+    limited_bits += bits;
+    unlimited_bits += ht.getUnlimitedBits();
+    max_length = std::max(max_length, ht.getMaxLength());
+}
+
+/**
+ * @brief method removing all the trees from the report
+ * 
+ */
+void LengthLimitReport::reset(){
+    std::lock_guard lk(m);
+    limited_bits = 0;
+    unlimited_bits = 0;
+    max_length = 0;
+}
+
+/**
+ * @brief method printing how much larger the encoding is because of the limit, and if the limit had to be raised
+ * 
+ * Nothing is printed if the codes were not limited.
+ * 
+ * @param out stream to print to
+ * @param requested_length maximum length of the codes asked for, 0 if not limited
+ */
+void LengthLimitReport::print(std::ostream &out, int requested_length){
+    std::lock_guard lk(m);
+    if(requested_length == 0){
+        return;
+    }
+    if(max_length > requested_length){
+        out << "Codes of " << requested_length << " bits cannot encode all the characters, the limit was raised to "
+            << max_length << " bits." << std::endl;
+    }
+    double loss = unlimited_bits == 0 ? 0 : 100.0 * (limited_bits - unlimited_bits) / unlimited_bits;
+    out << "Limiting codes to " << std::max(requested_length, max_length) << " bits makes the encoding "
+        << (limited_bits - unlimited_bits) / 8 << " bytes larger (" << loss << "% of the unrestricted encoding)." << std::endl;
+}
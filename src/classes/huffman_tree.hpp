@@ -11,6 +11,9 @@
 #include <memory>
 #include <vector>
 #include <queue>
+#include <mutex>
+#include <ostream>
+#include <cstdint>
 
 
 /**
@@ -28,7 +31,7 @@ class HuffmanNode{
          * @brief frequency of the character if node is a leaf, sum of the frequencies of the children subtrees otherwise
          * 
          */
-        int frequency;
+        uint64_t frequency;
         /**
          * @brief pointer to left child
          * 
@@ -45,10 +48,10 @@ class HuffmanNode{
          */
         std::shared_ptr<HuffmanNode> parent = nullptr;
     public:
-        HuffmanNode(unsigned char init_ch, int init_frequency);
+        HuffmanNode(unsigned char init_ch, uint64_t init_frequency);
 
         unsigned char getCh();
-        int getFrequency();
+        uint64_t getFrequency();
         std::shared_ptr<HuffmanNode> getLeftChild();
         std::shared_ptr<HuffmanNode> getRightChild();
         std::shared_ptr<HuffmanNode> getParent();
@@ -65,6 +68,8 @@ class HuffmanNode{
  * Only the pointer to the root of the tree is actually stored in the object, the rest of the
  * tree can be accessed by using the pointers stored in each node.
  * The implementation assumes that the file being encoded is an ASCII file and will probably break otherwise.
+ * Codes can be limited to a maximum length, in which case the lengths are computed with the package-merge algorithm
+ * and the tree is rebuilt from the corresponding canonical codes.
  * 
  */
 class HuffmanTree{
@@ -82,11 +87,77 @@ class HuffmanTree{
          * 
          */
         std::vector<std::pair<int, int>> code_table = std::vector<std::pair<int, int>>(256);
-        void extract_codes_rec(std::shared_ptr<HuffmanNode> huffman_tree, int code, int length);
+        /**
+         * @brief size of the encoding of the characters the tree was built from, with the codes before limiting
+         * their length
+         * 
+         */
+        uint64_t unlimited_bits = 0;
+        /**
+         * @brief maximum length of the codes, after raising it if it is too short for the number of characters
+         * 
+         */
+        int max_length = 0;
+        void extract_lengths_rec(std::shared_ptr<HuffmanNode> huffman_tree, int length);
+        void extract_codes_rec(std::shared_ptr<HuffmanNode> huffman_tree, uint64_t code, int length);
+        std::shared_ptr<HuffmanNode> build_from_codes_rec(std::vector<int> &chars, std::vector<uint64_t> &char_counts, int first, int last, int depth);
+
+        static std::vector<int> package_merge(std::vector<uint64_t> &char_counts, int max_length);
 
     public:
-        HuffmanTree(std::vector<int> char_counts);
+        /**
+         * @brief maximum length of a code, since codes are stored as integers
+         * 
+         */
+        static const int MAX_CODE_LENGTH = 32;
+
+        HuffmanTree(std::vector<uint64_t> char_counts, int max_length = 0);
         std::shared_ptr<HuffmanNode> getRoot();
         std::vector<std::pair<int, int>> getCodes();
+        std::vector<int> getCodeLengths();
+        std::vector<std::pair<int, int>> getCanonicalCodes();
+        uint64_t encodedBits(const std::vector<uint64_t> &char_counts);
+        uint64_t getUnlimitedBits();
+        int getMaxLength();
+
+        static std::vector<std::pair<int, int>> canonicalCodes(const std::vector<int> &code_lengths);
+        static bool tableBits(const std::vector<uint64_t> &char_counts, const std::vector<int> &code_lengths, uint64_t &n_bits);
+
+};
 
-};
\ No newline at end of file
+
+/**
+ * @brief class summing how much larger the encoding is because of the limit on the length of the codes, over all
+ * the trees built for an encoding
+ * 
+ * Trees can be added by more than one thread at a time.
+ * 
+ */
+class LengthLimitReport{
+    private:
+        /**
+         * @brief lock protecting the sums
+         * 
+         */
+        std::mutex m;
+        /**
+         * @brief size of the encodings with the limited codes
+         * 
+         */
+        uint64_t limited_bits = 0;
+        /**
+         * @brief size of the encodings with the codes of the Huffman trees
+         * 
+         */
+        uint64_t unlimited_bits = 0;
+        /**
+         * @brief largest maximum length of the codes of the trees
+         * 
+         */
+        int max_length = 0;
+
+    public:
+        void add(HuffmanTree &ht, const std::vector<uint64_t> &char_counts);
+        void reset();
+        void print(std::ostream &out, int requested_length);
+};
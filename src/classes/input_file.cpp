@@ -0,0 +1,75 @@
+/**
+ * @file input_file.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class reading parts of an input file from multiple threads
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "input_file.hpp"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+
+/**
+ * @brief Construct a new Input File:: Input File object
+ *
+ * @param filename path of the file to read, is_open should be checked before use
+ */
+InputFile::InputFile(const std::string &filename){
+    fd = open(filename.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if(fd >= 0 && fstat(fd, &file_stat) == 0){
+        length = file_stat.st_size;
+    }
+}
+
+/**
+ * @brief Destroy the Input File:: Input File object, closing the file
+ *
+ */
+InputFile::~InputFile(){
+    if(fd >= 0){
+        close(fd);
+    }
+}
+
+/**
+ * @brief method checking if the file was opened successfully
+ *
+ * @return true if the file can be read
+ * @return false otherwise
+ */
+bool InputFile::is_open(){return fd >= 0;}
+/**
+ * @brief getter method for the size of the file
+ *
+ * @return uint64_t
+ */
+uint64_t InputFile::size(){return length;}
+
+/**
+ * @brief method reading a part of the file, can be called by multiple threads at the same time
+ *
+ * @param offset position of the first byte to read
+ * @param size number of bytes to read
+ * @param buffer buffer to store the bytes in, at least size bytes long
+ * @return true if all the bytes were read
+ * @return false otherwise
+ */
+bool InputFile::read(uint64_t offset, size_t size, unsigned char *buffer){
+    size_t done = 0;
+    while(done < size){
+        ssize_t ret = pread(fd, buffer + done, size - done, offset + done);
+        if(ret < 0 && errno == EINTR){
+            continue;
+        }
+        if(ret <= 0){
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file input_file.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class reading parts of an input file from multiple threads
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ * @brief class reading an input file with positional reads
+ *
+ * Reads do not move a shared file position, so any number of threads can read different parts of the file
+ * at the same time through the same object, keeping multiple requests in flight to the device.
+ *
+ */
+class InputFile{
+    private:
+        /**
+         * @brief file descriptor of the file
+         *
+         */
+        int fd = -1;
+        /**
+         * @brief size of the file in bytes
+         *
+         */
+        uint64_t length = 0;
+
+    public:
+        InputFile(const std::string &filename);
+        ~InputFile();
+        InputFile(const InputFile &) = delete;
+        InputFile &operator=(const InputFile &) = delete;
+
+        bool is_open();
+        uint64_t size();
+        bool read(uint64_t offset, size_t size, unsigned char *buffer);
+};
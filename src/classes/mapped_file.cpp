@@ -0,0 +1,97 @@
+/**
+ * @file mapped_file.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class mapping an input file in memory
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "mapped_file.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/**
+ * @brief Construct a new Mapped File:: Mapped File object
+ *
+ * @param filename path of the file to map, is_open should be checked before use
+ */
+MappedFile::MappedFile(const std::string &filename){
+    fd = open(filename.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if(fd < 0 || fstat(fd, &file_stat) != 0){
+        return;
+    }
+    length = file_stat.st_size;
+    // empty files cannot be mapped, they are represented by an empty span
+    if(length == 0){
+        return;
+    }
+    void *ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(ptr == MAP_FAILED){
+        close(fd);
+        fd = -1;
+        return;
+    }
+    mapping = static_cast<unsigned char *>(ptr);
+    madvise(mapping, length, MADV_SEQUENTIAL);
+}
+
+/**
+ * @brief Destroy the Mapped File:: Mapped File object, unmapping the file
+ *
+ */
+MappedFile::~MappedFile(){
+    if(mapping != nullptr){
+        munmap(mapping, length);
+    }
+    if(fd >= 0){
+        close(fd);
+    }
+}
+
+/**
+ * @brief method checking if the file was mapped successfully
+ *
+ * @return true if the file can be read
+ * @return false otherwise
+ */
+bool MappedFile::is_open(){return fd >= 0;}
+/**
+ * @brief getter method for the size of the file
+ *
+ * @return size_t
+ */
+size_t MappedFile::size(){return length;}
+
+/**
+ * @brief method returning a view of a part of the file
+ *
+ * @param offset position of the first byte of the span
+ * @param size number of bytes of the span, must not go past the end of the file
+ * @return file_span
+ */
+file_span MappedFile::span(size_t offset, size_t size){
+    if(mapping == nullptr){
+        return {nullptr, 0};
+    }
+    return {mapping + offset, size};
+}
+
+/**
+ * @brief method asking the kernel to start reading a part of the file in the background
+ *
+ * @param offset position of the first byte to read
+ * @param size number of bytes to read
+ */
+void MappedFile::prefetch(size_t offset, size_t size){
+    if(mapping == nullptr || size == 0){
+        return;
+    }
+    // madvise needs an address aligned to a page
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t aligned_offset = offset / page_size * page_size;
+    madvise(mapping + aligned_offset, size + offset - aligned_offset, MADV_WILLNEED);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file mapped_file.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class mapping an input file in memory
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+
+/**
+ * @brief type storing a read only view of a part of a file in memory
+ *
+ */
+typedef struct{
+    const unsigned char *data;
+    size_t size;
+} file_span;
+
+/**
+ * @brief class mapping a whole file in memory in read only mode
+ *
+ * Pages are loaded by the kernel when first accessed, so no copy of the file is made and pages already in the
+ * page cache can be used immediately. The kernel is told that the file is read sequentially so that it reads ahead
+ * aggressively. The mapping is released when the object is destroyed, spans must not outlive it.
+ *
+ */
+class MappedFile{
+    private:
+        /**
+         * @brief file descriptor of the mapped file
+         *
+         */
+        int fd = -1;
+        /**
+         * @brief start of the mapping, nullptr for empty files
+         *
+         */
+        unsigned char *mapping = nullptr;
+        /**
+         * @brief size of the file in bytes
+         *
+         */
+        size_t length = 0;
+
+    public:
+        MappedFile(const std::string &filename);
+        ~MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool is_open();
+        size_t size();
+        file_span span(size_t offset, size_t size);
+        void prefetch(size_t offset, size_t size);
+};
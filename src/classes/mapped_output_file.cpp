@@ -0,0 +1,70 @@
+/**
+ * @file mapped_output_file.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class mapping an output file in memory
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "mapped_output_file.hpp"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/**
+ * @brief Construct a new Mapped Output File:: Mapped Output File object, truncating the file if it exists
+ *
+ * @param filename path of the file to write, is_open should be checked before use
+ * @param size final size of the file in bytes, must be positive
+ */
+MappedOutputFile::MappedOutputFile(const std::string &filename, size_t size){
+    // writable shared mappings need a descriptor open for reading too
+    fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        return;
+    }
+    // fallocate fails on file systems not supporting it, in which case the file is only extended
+    bool allocated = size > 0 && (fallocate(fd, 0, 0, size) == 0 || ftruncate(fd, size) == 0);
+    void *ptr = allocated ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if(ptr == MAP_FAILED){
+        close(fd);
+        fd = -1;
+        return;
+    }
+    mapping = static_cast<char *>(ptr);
+    length = size;
+}
+
+/**
+ * @brief Destroy the Mapped Output File:: Mapped Output File object, unmapping and closing the file
+ *
+ */
+MappedOutputFile::~MappedOutputFile(){
+    if(mapping != nullptr){
+        munmap(mapping, length);
+    }
+    if(fd >= 0){
+        close(fd);
+    }
+}
+
+/**
+ * @brief method checking if the file was created and mapped successfully
+ *
+ * @return true if the file can be written
+ * @return false otherwise
+ */
+bool MappedOutputFile::is_open(){return fd >= 0;}
+/**
+ * @brief getter method for the start of the mapping
+ *
+ * @return char*
+ */
+char *MappedOutputFile::data(){return mapping;}
+/**
+ * @brief getter method for the size of the file
+ *
+ * @return size_t
+ */
+size_t MappedOutputFile::size(){return length;}
@@ -0,0 +1,51 @@
+/**
+ * @file mapped_output_file.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class mapping an output file in memory
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+
+/**
+ * @brief class creating an output file of a known size and mapping it in memory
+ *
+ * Encoders write their output directly to the mapping, so no intermediate buffer is allocated and nothing is
+ * copied. The final size of the file must be known when it is created. Threads can write disjoint parts of the
+ * mapping at the same time. Pages are written back by the kernel, and the mapping is released when the object
+ * is destroyed.
+ *
+ */
+class MappedOutputFile{
+    private:
+        /**
+         * @brief file descriptor of the mapped file
+         *
+         */
+        int fd = -1;
+        /**
+         * @brief start of the mapping
+         *
+         */
+        char *mapping = nullptr;
+        /**
+         * @brief size of the file in bytes
+         *
+         */
+        size_t length = 0;
+
+    public:
+        MappedOutputFile(const std::string &filename, size_t size);
+        ~MappedOutputFile();
+        MappedOutputFile(const MappedOutputFile &) = delete;
+        MappedOutputFile &operator=(const MappedOutputFile &) = delete;
+
+        bool is_open();
+        char *data();
+        size_t size();
+};
@@ -0,0 +1,88 @@
+/**
+ * @file output_file.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class writing parts of an output file from multiple threads
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "output_file.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+
+/**
+ * @brief Construct a new Output File:: Output File object, truncating the file if it exists
+ *
+ * @param filename path of the file to write, is_open should be checked before use
+ */
+OutputFile::OutputFile(const std::string &filename){
+    fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+/**
+ * @brief Destroy the Output File:: Output File object, closing the file
+ *
+ */
+OutputFile::~OutputFile(){
+    if(fd >= 0){
+        close(fd);
+    }
+}
+
+/**
+ * @brief method checking if the file was opened successfully
+ *
+ * @return true if the file can be written
+ * @return false otherwise
+ */
+bool OutputFile::is_open(){return fd >= 0;}
+/**
+ * @brief getter method for the file descriptor, used to write the file in other ways
+ *
+ * @return int
+ */
+int OutputFile::getFd(){return fd;}
+
+/**
+ * @brief method setting the final size of the file, reserving the space on disk when the file system allows it
+ *
+ * The blocks are really taken on disk, unlike a sparse file, so the size must have been checked against the input
+ * it is computed from, for instance the chunks of an encoded file, before calling this method.
+ *
+ * @param size size of the file in bytes
+ * @return true if the file has the requested size
+ * @return false otherwise
+ */
+bool OutputFile::allocate(uint64_t size){
+    // fallocate fails on file systems not supporting it, in which case the file is only extended
+    if(size > 0 && fallocate(fd, 0, 0, size) == 0){
+        return true;
+    }
+    return ftruncate(fd, size) == 0;
+}
+
+/**
+ * @brief method writing a part of the file, can be called by multiple threads at the same time
+ *
+ * @param offset position of the first byte to write
+ * @param buffer buffer containing the bytes to write
+ * @param size number of bytes to write
+ * @return true if all the bytes were written
+ * @return false otherwise
+ */
+bool OutputFile::write(uint64_t offset, const char *buffer, size_t size){
+    size_t done = 0;
+    while(done < size){
+        ssize_t ret = pwrite(fd, buffer + done, size - done, offset + done);
+        if(ret < 0 && errno == EINTR){
+            continue;
+        }
+        if(ret <= 0){
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file output_file.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class writing parts of an output file from multiple threads
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ * @brief class writing an output file with positional writes
+ *
+ * The file is created with its final size, then each thread writes its own part at its offset
+ * without any synchronization with the others.
+ *
+ */
+class OutputFile{
+    private:
+        /**
+         * @brief file descriptor of the file
+         *
+         */
+        int fd = -1;
+
+    public:
+        OutputFile(const std::string &filename);
+        ~OutputFile();
+        OutputFile(const OutputFile &) = delete;
+        OutputFile &operator=(const OutputFile &) = delete;
+
+        bool is_open();
+        int getFd();
+        bool allocate(uint64_t size);
+        bool write(uint64_t offset, const char *buffer, size_t size);
+};
@@ -0,0 +1,367 @@
+/**
+ * @file pipe_encoder.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class encoding a stream of unknown length, such as the standard input
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "pipe_encoder.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "huffman_tree.hpp"
+#include "bit_writer.hpp"
+#include "histogram.hpp"
+#include "adaptive_encoder.hpp"
+
+
+/**
+ * @brief Construct a new Pipe Encoder:: Pipe Encoder object, opening the input and the output
+ *
+ * @param input path of the input, "-" for the standard input
+ * @param output path of the output, "-" for the standard output. Truncated if it exists
+ * @param block_size maximum number of characters of each block, must be positive
+ * @param n_threads number of threads to use, must be positive
+ * @param latency maximum time in msecs a character waits for its block to be closed, 0 to close blocks only
+ * when they are full or the input ends
+ * @param max_length maximum length of the codes, 0 if not limited
+ */
+PipeEncoder::PipeEncoder(const std::string &input, const std::string &output, uint64_t block_size, int n_threads,
+                            long latency, int max_length){
+    std_input = input == "-";
+    std_output = output == "-";
+    input_fd = std_input ? STDIN_FILENO : open(input.c_str(), O_RDONLY);
+    output_fd = std_output ? STDOUT_FILENO : open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    this->block_size = block_size;
+    this->n_threads = n_threads;
+    this->latency = latency;
+    this->max_length = max_length;
+}
+
+/**
+ * @brief Destroy the Pipe Encoder:: Pipe Encoder object, closing the files which are not standard streams
+ *
+ */
+PipeEncoder::~PipeEncoder(){
+    if(!std_input && input_fd >= 0){
+        close(input_fd);
+    }
+    if(!std_output && output_fd >= 0){
+        close(output_fd);
+    }
+}
+
+/**
+ * @brief method checking if the input and the output were opened successfully
+ *
+ * @return true if both can be used
+ * @return false otherwise
+ */
+bool PipeEncoder::is_open(){return input_fd >= 0 && output_fd >= 0;}
+/**
+ * @brief method setting the table used for all the blocks it can encode
+ *
+ * @param code_lengths lengths of the codes of the characters, 0 for characters without a code
+ */
+void PipeEncoder::preload(const std::vector<int> &code_lengths){preloaded_lengths = code_lengths;}
+/**
+ * @brief getter method for the number of blocks written in the last encoding
+ *
+ * @return int
+ */
+int PipeEncoder::getNBlocks(){return n_blocks;}
+/**
+ * @brief getter method for the number of tables written in the last encoding, the other blocks reuse them
+ *
+ * @return int
+ */
+int PipeEncoder::getNTables(){return n_tables;}
+/**
+ * @brief getter method for the number of characters encoded in the last encoding
+ *
+ * @return uint64_t
+ */
+uint64_t PipeEncoder::getNChars(){return n_chars;}
+/**
+ * @brief getter method for the longest time a block took from the arrival of its first character to the end of
+ * its write, in usecs
+ *
+ * @return long
+ */
+long PipeEncoder::getMaxDelay(){return max_delay;}
+/**
+ * @brief getter method for the time spent reading the input, waiting for it included
+ *
+ * @return long
+ */
+long PipeEncoder::getReadTime(){return read_time;}
+/**
+ * @brief getter method for the time spent counting the characters and building the codes
+ *
+ * @return long
+ */
+long PipeEncoder::getFreqTime(){return freq_time;}
+/**
+ * @brief getter method for the time spent encoding
+ *
+ * @return long
+ */
+long PipeEncoder::getEncodeTime(){return encode_time;}
+/**
+ * @brief getter method for the time spent writing the output
+ *
+ * @return long
+ */
+long PipeEncoder::getWriteTime(){return write_time;}
+/**
+ * @brief getter method for the cost of limiting the length of the codes of the tables built in the last encoding
+ *
+ * @return LengthLimitReport&
+ */
+LengthLimitReport &PipeEncoder::getLimitReport(){return limit_report;}
+
+/**
+ * @brief method reading the next block of the input, called by one thread at a time
+ *
+ * Waits for the first character, then reads until the block is full, the input ends or the latency bound
+ * has passed since the first character arrived.
+ *
+ * @param buffer buffer to store the block in, of block_size characters
+ * @param size where to store the number of characters read, 0 at the end of the input
+ * @param arrival where to store the time the first character of the block was read
+ * @return true if no error occurred
+ * @return false otherwise
+ */
+bool PipeEncoder::read_block(std::vector<unsigned char> &buffer, size_t &size, std::chrono::steady_clock::time_point &arrival){
+    size = 0;
+    while(size < block_size && !input_end){
+        // the first character is waited for without limit
+        int timeout = -1;
+        if(size > 0 && latency > 0){
+            auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - arrival).count();
+            if(waited >= latency){
+                break;
+            }
+            timeout = latency - waited;
+        }
+        pollfd input_poll = {input_fd, POLLIN, 0};
+        int ready = poll(&input_poll, 1, timeout);
+        if(ready < 0 && errno != EINTR){
+            return false;
+        }
+        if(ready <= 0){
+            continue;
+        }
+        ssize_t ret = read(input_fd, buffer.data() + size, block_size - size);
+        if(ret < 0 && (errno == EINTR || errno == EAGAIN)){
+            continue;
+        }
+        if(ret < 0){
+            return false;
+        }
+        if(ret == 0){
+            input_end = true;
+        }
+        else if(size == 0){
+            arrival = std::chrono::steady_clock::now();
+        }
+        size += ret;
+    }
+    return true;
+}
+
+/**
+ * @brief method writing a buffer to the output, retrying after partial writes
+ *
+ * @param buffer buffer containing the bytes to write
+ * @param size number of bytes to write
+ * @return true if all the bytes were written
+ * @return false otherwise
+ */
+bool PipeEncoder::write_all(const char *buffer, size_t size){
+    size_t done = 0;
+    while(done < size){
+        ssize_t ret = write(output_fd, buffer + done, size - done);
+        if(ret < 0 && errno == EINTR){
+            continue;
+        }
+        if(ret <= 0){
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
+
+/**
+ * @brief method encoding the input and writing it to the output, header included
+ *
+ * A thread takes the next block while holding the turn to read, then counts it, builds its codes, encodes it
+ * and writes it. The table of each block is chosen in order, then each block is written in order once all the
+ * previous ones are written.
+ *
+ * @param header stream header of the encoded file, with block_size characters per chunk
+ * @return true if the whole input was read and written
+ * @return false otherwise
+ */
+bool PipeEncoder::encode(FileHeader &header){
+    read_time = 0;
+    freq_time = 0;
+    encode_time = 0;
+    write_time = 0;
+    n_blocks = 0;
+    n_tables = 0;
+    n_chars = 0;
+    max_delay = 0;
+    limit_report.reset();
+    input_end = false;
+    std::atomic<bool> failed = !is_open();
+    // tracks the next block whose table has to be chosen and the next block to write, with the table in use
+    int table_id = 0;
+    int write_id = 0;
+    std::vector<int> current_lengths;
+    std::mutex read_m;
+    std::mutex m;
+    std::condition_variable cv;
+
+    auto header_buf = header.serialize();
+    if(!failed && !write_all(header_buf.data(), header_buf.size())){
+        failed = true;
+    }
+
+    auto encode_blocks = [&](int tid){
+        Timer timer;
+        std::vector<unsigned char> buffer(block_size);
+        std::vector<uint64_t> block_counts;
+        std::vector<char> output_buf;
+
+        while(true){
+            int i;
+            size_t size;
+            std::chrono::steady_clock::time_point arrival;
+            {
+                std::lock_guard lk(read_m);
+                if(failed || input_end){
+                    return;
+                }
+                timer.start("reading_input");
+                bool ok = read_block(buffer, size, arrival);
+                read_time += timer.stop();
+                if(!ok){
+                    failed = true;
+                }
+                // only blocks which were read are numbered, so that all of them go through both turns
+                if(!ok || size == 0){
+                    return;
+                }
+                i = n_blocks++;
+            }
+
+            timer.start("freq_time");
+            block_counts.assign(256, 0);
+            count_bytes(buffer.data(), size, block_counts);
+            uint64_t n_bits;
+            std::vector<int> code_lengths;
+            bool preloaded = HuffmanTree::tableBits(block_counts, preloaded_lengths, n_bits);
+            if(!preloaded){
+                HuffmanTree ht(block_counts, max_length);
+                code_lengths = ht.getCodeLengths();
+                limit_report.add(ht, block_counts);
+            }
+            freq_time += timer.stop();
+
+            // choose the table in order, the preloaded one has to be written again if another one was used since
+            bool own_table = true;
+            bool raw = false;
+            {
+                std::unique_lock lk(m);
+                while(i != table_id){
+                    cv.wait(lk);
+                }
+                uint64_t own_bits, reused_bits;
+                if(preloaded){
+                    code_lengths = preloaded_lengths;
+                    own_table = current_lengths != preloaded_lengths;
+                }
+                else{
+                    HuffmanTree::tableBits(block_counts, code_lengths, own_bits);
+                    own_bits += 8 * (header.serializeChunk(0, 0, &code_lengths).size() - header.serializeChunk(0, 0).size());
+                    if(HuffmanTree::tableBits(block_counts, current_lengths, reused_bits)
+                            && reused_bits * 100 <= own_bits * (100 + AdaptiveEncoder::REUSE_TOLERANCE)){
+                        own_table = false;
+                        code_lengths = current_lengths;
+                    }
+                    HuffmanTree::tableBits(block_counts, code_lengths, n_bits);
+                }
+                // blocks which would not shrink are stored raw without codes, the next blocks keep the previous table
+                uint64_t table_bits = own_table ? 8 * (header.serializeChunk(0, 0, &code_lengths).size() - header.serializeChunk(0, 0).size()) : 0;
+                raw = header.storeRaw(n_bits + table_bits, size);
+                if(raw){
+                    own_table = false;
+                }
+                else if(own_table){
+                    current_lengths = code_lengths;
+                    n_tables++;
+                }
+                table_id++;
+                cv.notify_all();
+            }
+
+            // the header of the chunk is filled after the encoding, since it may store its checksum
+            timer.start("encode");
+            uint64_t chunk_size = raw ? size : BitWriter::byte_size(n_bits);
+            char padding = raw ? FileHeader::RAW_CHUNK : BitWriter::padding(n_bits);
+            size_t chunk_header_size = header.serializeChunk(chunk_size, padding, own_table ? &code_lengths : nullptr, size).size();
+            output_buf.resize(chunk_header_size + (raw ? size : BitWriter::buffer_size(n_bits)));
+            if(raw){
+                std::copy(buffer.begin(), buffer.begin() + size, output_buf.begin() + chunk_header_size);
+            }
+            else{
+                BitWriter writer(HuffmanTree::canonicalCodes(code_lengths));
+                writer.encode(buffer.data(), size, output_buf.data() + chunk_header_size);
+            }
+            auto chunk_header = header.serializeChunk(chunk_size, padding, own_table ? &code_lengths : nullptr, size,
+                                                        output_buf.data() + chunk_header_size);
+            std::copy(chunk_header.begin(), chunk_header.end(), output_buf.begin());
+            encode_time += timer.stop();
+
+            // wait until the block can be written, blocks are still taken in turn after a failure
+            // so that no thread waits forever
+            std::unique_lock lk(m);
+            while(i != write_id){
+                cv.wait(lk);
+            }
+            if(!failed){
+                timer.start("write");
+                if(!write_all(output_buf.data(), chunk_header.size() + chunk_size)){
+                    failed = true;
+                }
+                write_time += timer.stop();
+                n_chars += size;
+                auto delay = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - arrival).count();
+                max_delay = std::max(max_delay, long(delay));
+            }
+            write_id++;
+            cv.notify_all();
+        }
+    };
+
+    if(!failed){
+        ThreadPool::shared(n_threads).run(encode_blocks);
+    }
+
+    // an empty chunk ends the stream
+    auto end_chunk = header.serializeChunk(0, 0, nullptr, 0);
+    if(!failed && !write_all(end_chunk.data(), end_chunk.size())){
+        failed = true;
+    }
+    return !failed;
+}
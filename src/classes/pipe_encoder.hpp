@@ -0,0 +1,165 @@
+/**
+ * @file pipe_encoder.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class encoding a stream of unknown length, such as the standard input
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include "file_header.hpp"
+#include "huffman_tree.hpp"
+
+
+/**
+ * @brief class encoding a stream in blocks as they arrive, writing each block as soon as it is encoded
+ *
+ * The input and the output are read and written sequentially, so they can be pipes: "-" stands for the standard
+ * input or output. The length of the input is not known, so the output uses the stream header, where each chunk
+ * stores its number of characters and the file ends with an empty chunk.
+ * A block is closed when it is full, when the input ends or when the latency bound has passed since its first
+ * character arrived, so a slow producer does not delay its data. Each block builds its own codes, or keeps the
+ * table of the previous block as in AdaptiveEncoder. A preloaded table is used instead for the blocks it can
+ * encode, so that no table has to be chosen for them.
+ * Threads take turns reading, encode their blocks in parallel and write them in order. Every thread holds at
+ * most one block and its encoding at a time, so the memory used only depends on the size of the blocks and on
+ * the number of threads.
+ *
+ */
+class PipeEncoder{
+    private:
+        /**
+         * @brief descriptor of the input
+         *
+         */
+        int input_fd = -1;
+        /**
+         * @brief descriptor of the output
+         *
+         */
+        int output_fd = -1;
+        /**
+         * @brief whether the input is the standard input, which is not closed
+         *
+         */
+        bool std_input;
+        /**
+         * @brief whether the output is the standard output, which is not closed
+         *
+         */
+        bool std_output;
+        /**
+         * @brief maximum number of characters of a block
+         *
+         */
+        uint64_t block_size;
+        /**
+         * @brief number of threads reading and encoding blocks
+         *
+         */
+        int n_threads;
+        /**
+         * @brief maximum time a character waits in a block which is not full, in msecs. 0 if not bounded
+         *
+         */
+        long latency;
+        /**
+         * @brief maximum length of the codes, 0 if not limited
+         *
+         */
+        int max_length;
+        /**
+         * @brief lengths of the codes of the preloaded table, empty if there is none
+         *
+         */
+        std::vector<int> preloaded_lengths;
+        /**
+         * @brief set when the end of the input is reached
+         *
+         */
+        bool input_end = false;
+        /**
+         * @brief number of blocks written in the last encoding
+         *
+         */
+        int n_blocks = 0;
+        /**
+         * @brief number of tables written in the last encoding
+         *
+         */
+        int n_tables = 0;
+        /**
+         * @brief number of characters encoded in the last encoding
+         *
+         */
+        uint64_t n_chars = 0;
+        /**
+         * @brief longest time between the arrival of the first character of a block and the end of its write, in usecs
+         *
+         */
+        long max_delay = 0;
+        /**
+         * @brief time spent reading the input, waiting for it included
+         *
+         */
+        std::atomic<long> read_time = 0;
+        /**
+         * @brief time spent counting and building the codes, summed between threads
+         *
+         */
+        std::atomic<long> freq_time = 0;
+        /**
+         * @brief time spent encoding, summed between threads
+         *
+         */
+        std::atomic<long> encode_time = 0;
+        /**
+         * @brief time spent writing the output
+         *
+         */
+        std::atomic<long> write_time = 0;
+        /**
+         * @brief cost of limiting the length of the codes of the tables built in the last encoding
+         *
+         */
+        LengthLimitReport limit_report;
+
+        bool read_block(std::vector<unsigned char> &buffer, size_t &size, std::chrono::steady_clock::time_point &arrival);
+        bool write_all(const char *buffer, size_t size);
+
+    public:
+        /**
+         * @brief default latency bound in msecs, short enough for interactive use while keeping blocks large
+         * when the input arrives quickly
+         *
+         */
+        static const long DEFAULT_LATENCY = 100;
+
+        PipeEncoder(const std::string &input, const std::string &output, uint64_t block_size, int n_threads,
+                    long latency, int max_length = 0);
+        ~PipeEncoder();
+        PipeEncoder(const PipeEncoder &) = delete;
+        PipeEncoder &operator=(const PipeEncoder &) = delete;
+
+        bool is_open();
+        void preload(const std::vector<int> &code_lengths);
+        int getNBlocks();
+        int getNTables();
+        uint64_t getNChars();
+        long getMaxDelay();
+        long getReadTime();
+        long getFreqTime();
+        long getEncodeTime();
+        long getWriteTime();
+        LengthLimitReport &getLimitReport();
+
+        bool encode(FileHeader &header);
+};
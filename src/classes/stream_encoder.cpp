@@ -0,0 +1,257 @@
+/**
+ * @file stream_encoder.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class encoding a file in blocks without loading it in memory
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "stream_encoder.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "histogram.hpp"
+
+
+/**
+ * @brief Construct a new Stream Encoder:: Stream Encoder object
+ *
+ * @param filename path of the file to encode
+ * @param block_size number of characters of each block, must be positive
+ * @param n_threads number of threads to use, must be positive
+ */
+StreamEncoder::StreamEncoder(const std::string &filename, uint64_t block_size, int n_threads) : file(filename){
+    this->filesize = file.size();
+    this->block_size = block_size;
+    this->n_threads = n_threads;
+}
+
+/**
+ * @brief method computing the number of blocks the file is split in, an empty file still has one empty block
+ *
+ * @return int
+ */
+int StreamEncoder::getNBlocks(){return std::max(uint64_t(1), (filesize + block_size - 1) / block_size);}
+/**
+ * @brief getter method for the number of characters of each block apart from the last one
+ *
+ * @return uint64_t
+ */
+uint64_t StreamEncoder::getBlockSize(){return block_size;}
+/**
+ * @brief getter method for the time spent reading the file in the last pass
+ *
+ * @return long
+ */
+long StreamEncoder::getReadTime(){return read_time;}
+/**
+ * @brief getter method for the time spent counting or encoding in the last pass
+ *
+ * @return long
+ */
+long StreamEncoder::getComputeTime(){return compute_time;}
+/**
+ * @brief getter method for the time spent writing the output in the last pass
+ *
+ * @return long
+ */
+long StreamEncoder::getWriteTime(){return write_time;}
+
+/**
+ * @brief method reading a block of the file, blocks are read with positional reads so that threads do not
+ * need to synchronize
+ *
+ * @param block index of the block
+ * @param buffer buffer to store the block in, resized to the size of the block
+ * @return true if the whole block was read
+ * @return false otherwise
+ */
+bool StreamEncoder::read_block(int block, std::vector<unsigned char> &buffer){
+    uint64_t offset = block * block_size;
+    buffer.resize(std::min(block_size, filesize - offset));
+    return file.read(offset, buffer.size(), buffer.data());
+}
+
+/**
+ * @brief method counting the characters of the file, first pass
+ *
+ * Blocks are assigned to threads dynamically through a shared counter, each thread counts in its own vector.
+ *
+ * @param char_counts vector where to store the frequencies of the characters
+ * @return true if the whole file was read
+ * @return false otherwise
+ */
+bool StreamEncoder::count(std::vector<uint64_t> &char_counts){
+    read_time = 0;
+    compute_time = 0;
+    write_time = 0;
+    std::atomic<int> next_block = 0;
+    int n_blocks = getNBlocks();
+
+    ThreadPool &pool = ThreadPool::shared(n_threads);
+    std::vector<std::vector<uint64_t>> thread_counts(pool.size());
+
+    auto count_blocks = [this, &next_block, &thread_counts, n_blocks](int tid){
+        Timer timer;
+        std::vector<unsigned char> buffer;
+        auto &partial_counts = thread_counts[tid];
+        partial_counts.assign(256, 0);
+        bool ok = file.is_open();
+        for(int i = next_block++; ok && i < n_blocks; i = next_block++){
+            timer.start("reading_input");
+            ok = read_block(i, buffer);
+            read_time += timer.stop();
+
+            timer.start("freq_time");
+            count_bytes(buffer.data(), buffer.size(), partial_counts);
+            compute_time += timer.stop();
+        }
+        // let the other threads stop as well
+        if(!ok){
+            next_block = n_blocks;
+            partial_counts.clear();
+        }
+    };
+    pool.run(count_blocks);
+
+    bool ok = true;
+    char_counts.assign(256, 0);
+    for(auto &partial_counts : thread_counts){
+        ok &= partial_counts.size() == 256;
+        for(int i=0; i<partial_counts.size(); i++){
+            char_counts[i] += partial_counts[i];
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief method estimating the frequencies of the characters from a sample of the file, replaces the first pass
+ *
+ * @param sample_size number of characters to count
+ * @param char_counts vector where to store the estimated frequencies of the characters, see sample_bytes
+ * @return true if the sample was read
+ * @return false otherwise
+ */
+bool StreamEncoder::sample(uint64_t sample_size, std::vector<uint64_t> &char_counts){
+    read_time = 0;
+    compute_time = 0;
+    write_time = 0;
+    Timer timer;
+    timer.start("sample");
+    bool ok = file.is_open() && sample_bytes(file, sample_size, char_counts);
+    compute_time = timer.stop();
+    return ok;
+}
+
+/**
+ * @brief method encoding the file and writing it after the header, second pass
+ *
+ * Blocks are assigned to threads dynamically through a shared counter. A thread encoding a block waits for
+ * the previous blocks to be written before writing it and claiming the next one.
+ *
+ * @param writer object storing the table of encodings
+ * @param header header of the encoded file, used to write the header of each chunk
+ * @param output stream to write to, the header of the file must already be written
+ * @param char_counts if not null, where to store the frequencies of the characters, counted while encoding.
+ * Used to evaluate codes built from estimated frequencies
+ * @return true if the whole file was read
+ * @return false otherwise
+ */
+bool StreamEncoder::encode(const BitWriter &writer, FileHeader &header, std::ostream &output, std::vector<uint64_t> *char_counts){
+    read_time = 0;
+    compute_time = 0;
+    write_time = 0;
+    std::atomic<int> next_block = 0;
+    std::atomic<bool> failed = false;
+    int n_blocks = getNBlocks();
+    // tracks the next encoded block to write to file
+    int write_id = 0;
+    std::mutex m;
+    std::condition_variable cv;
+    if(char_counts != nullptr){
+        char_counts->assign(256, 0);
+    }
+
+    auto encode_blocks = [&](int tid){
+        Timer timer;
+        std::vector<unsigned char> buffer;
+        std::vector<uint64_t> partial_counts(256, 0);
+        std::vector<uint64_t> block_counts;
+        // the counts of the block are unknown, so the buffer is sized for the longest code
+        std::vector<char> buffer_vec(BitWriter::buffer_size(block_size * writer.max_length()));
+        bool ok = file.is_open();
+
+        for(int i = next_block++; i < n_blocks; i = next_block++){
+            uint64_t n_bits = 0;
+            bool raw = false;
+            std::vector<char> chunk_header;
+            if(ok && !failed){
+                timer.start("reading_input");
+                ok = read_block(i, buffer);
+                read_time += timer.stop();
+
+                // the size of the encoding is computed from the counts of the block, blocks which would not shrink
+                // are stored raw without encoding them
+                timer.start("encode");
+                block_counts.assign(256, 0);
+                count_bytes(buffer.data(), buffer.size(), block_counts);
+                raw = header.storeRaw(writer.encoded_bits(block_counts), buffer.size());
+                if(!raw){
+                    n_bits = writer.encode(buffer.data(), buffer.size(), buffer_vec.data());
+                }
+                // the header of the chunk is built while its bytes are in cache, it may store their checksum
+                if(raw){
+                    chunk_header = header.serializeChunk(buffer.size(), FileHeader::RAW_CHUNK, nullptr, 0,
+                                                            reinterpret_cast<const char *>(buffer.data()));
+                }
+                else{
+                    chunk_header = header.serializeChunk(BitWriter::byte_size(n_bits), BitWriter::padding(n_bits), nullptr, 0,
+                                                            buffer_vec.data());
+                }
+                if(char_counts != nullptr){
+                    for(int c=0; c<256; c++){
+                        partial_counts[c] += block_counts[c];
+                    }
+                }
+                compute_time += timer.stop();
+            }
+            if(!ok){
+                failed = true;
+            }
+
+            // wait until the block can be written, blocks are still taken in turn after a failure
+            // so that no thread waits forever
+            std::unique_lock lk(m);
+            while(i != write_id){
+                cv.wait(lk);
+            }
+            if(!failed){
+                timer.start("write");
+                output.write(chunk_header.data(), chunk_header.size());
+                if(raw){
+                    output.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+                }
+                else{
+                    output.write(buffer_vec.data(), BitWriter::byte_size(n_bits));
+                }
+                write_time += timer.stop();
+            }
+            write_id++;
+            cv.notify_all();
+        }
+
+        if(char_counts != nullptr){
+            std::unique_lock lk(m);
+            for(int c=0; c<256; c++){
+                (*char_counts)[c] += partial_counts[c];
+            }
+        }
+    };
+
+    ThreadPool::shared(n_threads).run(encode_blocks);
+    return !failed && output.good();
+}
@@ -0,0 +1,84 @@
+/**
+ * @file stream_encoder.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class encoding a file in blocks without loading it in memory
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <atomic>
+#include <cstdint>
+
+#include "bit_writer.hpp"
+#include "file_header.hpp"
+#include "input_file.hpp"
+
+
+/**
+ * @brief class encoding a file in fixed size blocks, reading it while encoding
+ *
+ * The file is read twice: a first pass counts the characters, a second one reads, encodes and writes each block.
+ * Each block is written as a chunk of the encoded file, so the header must be built with getNBlocks chunks
+ * of getBlockSize characters and a version supporting uneven chunks.
+ * Every thread holds at most one block and its encoding at a time and blocks are written in order as soon as
+ * they are ready, so the memory used only depends on the size of the blocks and on the number of threads.
+ *
+ */
+class StreamEncoder{
+    private:
+        /**
+         * @brief file to encode, shared by all the threads
+         *
+         */
+        InputFile file;
+        /**
+         * @brief size of the file to encode in bytes
+         *
+         */
+        uint64_t filesize;
+        /**
+         * @brief number of characters of each block apart from the last one
+         *
+         */
+        uint64_t block_size;
+        /**
+         * @brief number of threads reading and encoding blocks
+         *
+         */
+        int n_threads;
+        /**
+         * @brief time spent reading the file in the last pass, summed between threads
+         *
+         */
+        std::atomic<long> read_time = 0;
+        /**
+         * @brief time spent counting or encoding in the last pass, summed between threads
+         *
+         */
+        std::atomic<long> compute_time = 0;
+        /**
+         * @brief time spent writing the output in the last pass, summed between threads
+         *
+         */
+        std::atomic<long> write_time = 0;
+
+        bool read_block(int block, std::vector<unsigned char> &buffer);
+
+    public:
+        StreamEncoder(const std::string &filename, uint64_t block_size, int n_threads);
+
+        int getNBlocks();
+        uint64_t getBlockSize();
+        long getReadTime();
+        long getComputeTime();
+        long getWriteTime();
+
+        bool count(std::vector<uint64_t> &char_counts);
+        bool sample(uint64_t sample_size, std::vector<uint64_t> &char_counts);
+        bool encode(const BitWriter &writer, FileHeader &header, std::ostream &output, std::vector<uint64_t> *char_counts = nullptr);
+};
@@ -0,0 +1,152 @@
+/**
+ * @file thread_pool.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the implementation of the class keeping a set of worker threads alive between parallel phases
+ * @date 2026-10-18
+ *
+ *
+ */
+#include "thread_pool.hpp"
+#include <pthread.h>
+#include <sched.h>
+
+#include "cpu_topology.hpp"
+
+
+/**
+ * @brief Construct a new Thread Pool:: Thread Pool object, starting the workers
+ *
+ * @param n_threads number of workers, must be positive
+ * @param worker_cpus CPU of each worker, empty to leave the workers free to move between CPUs
+ */
+ThreadPool::ThreadPool(int n_threads, const std::vector<int> &worker_cpus){
+    CpuTopology topology;
+    for(int i=0; i<n_threads; i++){
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+        worker_nodes.push_back(0);
+        if(i < worker_cpus.size()){
+            cpu_set_t cpu;
+            CPU_ZERO(&cpu);
+            CPU_SET(worker_cpus[i], &cpu);
+            // pinning is only a hint for performance, workers still run if it fails
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(cpu), &cpu);
+            worker_nodes.back() = topology.getNode(worker_cpus[i]);
+        }
+    }
+}
+
+/**
+ * @brief Destroy the Thread Pool:: Thread Pool object, waiting for the workers to exit
+ *
+ */
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard lk(m);
+        stop = true;
+    }
+    start_cv.notify_all();
+    for(auto &w : workers){
+        w.join();
+    }
+}
+
+/**
+ * @brief getter method for the number of workers
+ *
+ * @return int
+ */
+int ThreadPool::size(){return workers.size();}
+/**
+ * @brief method returning the NUMA node of the CPU a worker is pinned to
+ *
+ * @param worker index of the worker
+ * @return int node of the worker, 0 if it is not pinned
+ */
+int ThreadPool::getNode(int worker){return worker_nodes[worker];}
+/**
+ * @brief getter method for the time spent by the caller to start the last phase, in usecs
+ *
+ * @return long
+ */
+long ThreadPool::getDispatchTime(){return dispatch_time;}
+
+/**
+ * @brief method running a function on all the workers and waiting for them to finish
+ *
+ * @param task function to run, called with the index of each worker
+ */
+void ThreadPool::run(const std::function<void(int)> &task){
+    std::lock_guard run_lk(run_m);
+    std::unique_lock lk(m);
+    this->task = &task;
+    running = workers.size();
+    auto start_time = std::chrono::steady_clock::now();
+    generation++;
+    start_cv.notify_all();
+    dispatch_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+    while(running > 0){
+        done_cv.wait(lk);
+    }
+    this->task = nullptr;
+}
+
+/**
+ * @brief body of the workers, runs each phase once and sleeps until the next one
+ *
+ * @param id index of the worker
+ */
+void ThreadPool::worker_loop(int id){
+    uint64_t last_generation = 0;
+    std::unique_lock lk(m);
+    while(true){
+        while(!stop && generation == last_generation){
+            start_cv.wait(lk);
+        }
+        if(stop){
+            return;
+        }
+        last_generation = generation;
+        auto current_task = task;
+        lk.unlock();
+
+        (*current_task)(id);
+
+        lk.lock();
+        if(--running == 0){
+            done_cv.notify_one();
+        }
+    }
+}
+
+/**
+ * @brief method returning a pool shared by the whole process
+ *
+ * The pool is created on the first call and kept until the process exits, a new one replaces it only if a
+ * different number of threads or a different placement is requested. Must not be called while a phase is running
+ * on the pool.
+ *
+ * @param n_threads number of workers, must be positive
+ * @param affinity placement of the workers, see CpuTopology::placement. Empty to keep the one of the current pool,
+ * or not to pin the workers if there is none. Workers are not pinned if the placement is not valid
+ * @return ThreadPool&
+ */
+ThreadPool &ThreadPool::shared(int n_threads, const std::string &affinity){
+    static std::mutex shared_m;
+    static std::unique_ptr<ThreadPool> pool;
+    static std::string pool_affinity = "none";
+    std::lock_guard lk(shared_m);
+    if(pool == nullptr || pool->size() != n_threads || (affinity != "" && affinity != pool_affinity)){
+        if(affinity != ""){
+            pool_affinity = affinity;
+        }
+        CpuTopology topology;
+        std::vector<int> worker_cpus;
+        if(!topology.placement(pool_affinity, n_threads, worker_cpus)){
+            worker_cpus.clear();
+        }
+        // the old workers exit before the new ones are created
+        pool.reset();
+        pool = std::make_unique<ThreadPool>(n_threads, worker_cpus);
+    }
+    return *pool;
+}
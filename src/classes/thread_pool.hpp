@@ -0,0 +1,105 @@
+/**
+ * @file thread_pool.hpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief header for the class keeping a set of worker threads alive between parallel phases
+ * @date 2026-10-18
+ *
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+
+/**
+ * @brief class running parallel phases on a fixed set of threads created once
+ *
+ * Workers can be pinned to a CPU each, see CpuTopology::placement for how CPUs are chosen. A phase is a function
+ * called by every worker with its index, run returns once all the workers are done with it, so it also acts
+ * as a barrier. Workers sleep between phases, starting a phase only costs waking them up.
+ * Memory used by a single worker should be allocated and first touched by the worker itself, so that it is placed
+ * on the NUMA node of its CPU.
+ * A process wide pool can be obtained with shared, so that threads are created once even when encoding many files.
+ *
+ */
+class ThreadPool{
+    private:
+        /**
+         * @brief worker threads
+         *
+         */
+        std::vector<std::thread> workers;
+        /**
+         * @brief NUMA node of the CPU of each worker, 0 for workers which are not pinned
+         *
+         */
+        std::vector<int> worker_nodes;
+        /**
+         * @brief lock protecting the state of the current phase
+         *
+         */
+        std::mutex m;
+        /**
+         * @brief lock allowing a single phase at a time when the pool is shared between threads
+         *
+         */
+        std::mutex run_m;
+        /**
+         * @brief used to wake the workers when a phase starts
+         *
+         */
+        std::condition_variable start_cv;
+        /**
+         * @brief used to wake the caller of run when the last worker is done
+         *
+         */
+        std::condition_variable done_cv;
+        /**
+         * @brief function run by the workers in the current phase
+         *
+         */
+        const std::function<void(int)> *task = nullptr;
+        /**
+         * @brief number of phases started, workers compare it to the last phase they ran
+         *
+         */
+        uint64_t generation = 0;
+        /**
+         * @brief number of workers still running the current phase
+         *
+         */
+        int running = 0;
+        /**
+         * @brief set when the pool is destroyed
+         *
+         */
+        bool stop = false;
+        /**
+         * @brief time spent by the caller to start the last phase, waking the workers, in usecs
+         *
+         */
+        long dispatch_time = 0;
+
+        void worker_loop(int id);
+
+    public:
+        ThreadPool(int n_threads, const std::vector<int> &worker_cpus = {});
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        int size();
+        int getNode(int worker);
+        long getDispatchTime();
+        void run(const std::function<void(int)> &task);
+
+        static ThreadPool &shared(int n_threads, const std::string &affinity = "");
+};
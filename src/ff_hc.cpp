@@ -12,247 +12,625 @@
 #include <fstream>
 #include <filesystem>
 #include <future>
+#include <climits>
+#include <algorithm>
+#include <map>
 #include <ff/ff.hpp>
 #include <ff/farm.hpp>
-#include <ff/parallel_for.hpp>
+#include <ff/pipeline.hpp>
 #include "logger.hpp"
 #include "huffman_tree.hpp"
+#include "bit_writer.hpp"
+#include "file_header.hpp"
+#include "mapped_file.hpp"
+#include "input_file.hpp"
+#include "output_file.hpp"
+#include "async_writer.hpp"
+#include "mapped_output_file.hpp"
+#include "histogram.hpp"
+#include "cpu_topology.hpp"
+#include "encoder_options.hpp"
+#include "stream_encoder.hpp"
+#include "pipe_encoder.hpp"
 
 using std::cout, std::clog, std::endl, std::string, std::vector, std::shared_ptr;
 using namespace ff;
 
-// tracks the next encoded chunk to write to file
-int write_id = 0;
-
-void print_help(){
-    cout << "The program accepts the following arguments:" << endl;
-    cout << "\t -i path: path to the file to be encoded, required." << endl;
-    cout << "\t -o path: path where the encoded file has to be saved, required." << endl;
-    cout << "\t -t number: number of threads to use, default 4." << endl;
-    cout << "\t -v: set verbose." << endl;
-    cout << "\t -l dir: enable logging to file, output is written to directory dir." << endl;
-    cout << "\t -d: debug mode, only works if logging is enabled." << endl;
-}
+/**
+ * @brief type of the tasks of the counting farm, describing a chunk of the file
+ * 
+ * All the descriptors are allocated before the farm starts and passed by pointer, so no memory is allocated
+ * or freed for each task.
+ * 
+ */
+typedef struct{
+    int chunk;
+} count_task;
 
 /**
  * @brief emitter node for the farm to count characters
  * 
- * Reads file in chunks and communicates the current working id to a worker.
- * File chunks are stored through pointers for easier sharing between threads.
+ * Splits the mapped file in chunks of a fixed size and sends the descriptor of each chunk to the first free worker,
+ * so that counting starts as soon as the first chunk is available.
+ * File chunks are views into the mapping stored through pointers for easier sharing between threads,
+ * pages not yet in memory are read in the background while the workers count.
+ * With positional reads there is no mapping and the workers read the chunks they receive.
  * 
  */
-class Reader : public ff_monode_t<int>{
+class Reader : public ff_monode_t<count_task>{
 private:
-    int n_workers;
-    vector<shared_ptr<vector<unsigned char>>> file_chunks;
+    uint64_t chunk_size;
+    vector<shared_ptr<file_span>> file_chunks;
     shared_ptr<long> read_time;
-    string filename;
+    shared_ptr<MappedFile> file;
+    shared_ptr<vector<count_task>> tasks;
     bool debug;
 public:
-    Reader(int n_workers, vector<shared_ptr<vector<unsigned char>>> file_chunks, string filename, shared_ptr<long> read_time, bool debug){
-        this->filename = filename;
-        this->n_workers = n_workers;
+    Reader(uint64_t chunk_size, vector<shared_ptr<file_span>> file_chunks, shared_ptr<MappedFile> file, shared_ptr<long> read_time,
+            shared_ptr<vector<count_task>> tasks, bool debug){
+        this->file = file;
+        this->chunk_size = chunk_size;
         this->file_chunks = file_chunks;
         this->read_time = read_time;
+        this->tasks = tasks;
         this->debug = debug;
     }
-    int * svc(int * in){
+    count_task * svc(count_task * in){
         Timer timer;
-        std::ifstream file(filename);
+        int n_chunks = file_chunks.size();
 
-        std::stringstream file_buffer;
-
-        // the call to standard library used in the other versions does not work for some reason
-        auto filesize = file.tellg();
-        file.seekg( 0, std::ios::end );
-        filesize = file.tellg() - filesize;
-        file.clear();
-        file.seekg(0, std::ios::beg);
-        
         *read_time = 0;
-        // compute size of a single chunk
-        auto chunk_size = filesize / n_workers;
-        for(int i=0; i<n_workers; i++){
+        timer.start("reading");
+        if(file != nullptr){
+            file->prefetch(0, file->size());
+        }
+        *read_time += timer.stop();
+        for(int i=0; i<n_chunks; i++){
             
             timer.start("reading");
-            long read_size = chunk_size;
-            if(i==n_workers-1){
-                read_size += filesize % n_workers;
+            if(file != nullptr){
+                *file_chunks[i] = file->span(i * chunk_size, file_chunks[i]->size);
             }
-            file_chunks[i]->resize(read_size);
-            file.read(reinterpret_cast<char *>(&(*(file_chunks[i]))[0]), read_size);
             *read_time += timer.stop();
 
-            if(!debug){ff_send_out(new int(i), i%n_workers);}
+            (*tasks)[i].chunk = i;
+            if(!debug){ff_send_out(&(*tasks)[i]);}
         }
 
         if(debug){
-            for(int i=0; i<n_workers; i++){
-                ff_send_out(new int(i), i%n_workers);
+            for(int i=0; i<n_chunks; i++){
+                ff_send_out(&(*tasks)[i]);
             }
         }
 
-        file.close();
         return EOS;
     }
 
 };
 
-class freqTask : public ff_node_t<int>{
+/**
+ * @brief worker node for the farm to count characters
+ * 
+ * Counts the characters of each chunk it receives in the counts of the chunk, then sends the descriptor
+ * to the collector.
+ * With positional reads the worker first reads the chunk into its own buffer, reused for all its chunks, so that
+ * the file is never held in memory. The chunks are read again by the encoding pipeline.
+ * The worker is pinned to its CPU before receiving chunks and allocates all the memory it writes, so that it is
+ * placed on the memory node of the CPU.
+ * 
+ */
+class freqTask : public ff_node_t<count_task>{
 private:
-    shared_ptr<vector<int>> partial_counts;
-    shared_ptr<vector<unsigned char>> file_chunk;
+    shared_ptr<vector<vector<uint64_t>>> chunk_counts;
+    vector<shared_ptr<file_span>> file_chunks;
     shared_ptr<vector<long>> freq_time_vec;
+    shared_ptr<InputFile> input;
+    uint64_t chunk_size;
+    // chunk being counted, only used with positional reads
+    std::unique_ptr<unsigned char[]> buffer;
+    shared_ptr<vector<long>> read_time_vec;
+    int worker;
+    int cpu;
 public:
-    freqTask(shared_ptr<vector<int>> partial_counts, shared_ptr<vector<unsigned char>> file_chunk,
-            shared_ptr<vector<long>> freq_time_vec){
-        this->partial_counts = partial_counts;
-        this->file_chunk = file_chunk;
+    freqTask(shared_ptr<vector<vector<uint64_t>>> chunk_counts, vector<shared_ptr<file_span>> file_chunks,
+            shared_ptr<vector<long>> freq_time_vec, shared_ptr<InputFile> input, uint64_t chunk_size,
+            shared_ptr<vector<long>> read_time_vec, int worker, int cpu){
+        this->chunk_counts = chunk_counts;
+        this->file_chunks = file_chunks;
         this->freq_time_vec = freq_time_vec;
+        this->input = input;
+        this->chunk_size = chunk_size;
+        this->read_time_vec = read_time_vec;
+        this->worker = worker;
+        this->cpu = cpu;
     }
-    int * svc(int * i ){
+    int svc_init(){
+        // -1 means that the worker is not pinned
+        if(cpu >= 0){
+            CpuTopology::pin(cpu);
+        }
+        return 0;
+    }
+    count_task * svc(count_task * task){
         Timer timer;
-        timer.start("freq");
-        for(int j=0; j<file_chunk->size(); j++){
-            (*partial_counts)[int((*file_chunk)[j])]++;
+        int i = task->chunk;
+        auto &file_chunk = file_chunks[i];
+        // after a failed read the remaining chunks are skipped
+        if((*read_time_vec)[worker] < 0){
+            return GO_ON;
         }
-        (*freq_time_vec)[*i] = timer.stop();
-        free(i);
-        return i;
+        const unsigned char *data = file_chunk->data;
+        if(input != nullptr){
+            timer.start("reading");
+            // allocated by the worker, so that it is on the memory node of its CPU
+            if(buffer == nullptr){
+                buffer.reset(new unsigned char[chunk_size]);
+            }
+            if(!input->read(i * chunk_size, file_chunk->size, buffer.get())){
+                error("reading chunk\n");
+                (*read_time_vec)[worker] = -1;
+                return GO_ON;
+            }
+            data = buffer.get();
+            (*read_time_vec)[worker] += timer.stop();
+        }
+        timer.start("freq");
+        auto &counts = (*chunk_counts)[i];
+        counts.assign(256, 0);
+        count_bytes(data, file_chunk->size, counts);
+        (*freq_time_vec)[worker] += timer.stop();
+        return task;
     }
 
 };
 
+/**
+ * @brief collector node for the farm to count characters
+ * 
+ * Adds the counts of each chunk to the counts of the whole file as soon as the chunk is counted,
+ * so that no reduction is left once the farm ends.
+ * 
+ */
+class CountCollector : public ff_minode_t<count_task>{
+private:
+    shared_ptr<vector<vector<uint64_t>>> chunk_counts;
+    vector<uint64_t> *count_vector;
+    long join_time = 0;
+public:
+    CountCollector(shared_ptr<vector<vector<uint64_t>>> chunk_counts, vector<uint64_t> *count_vector){
+        this->chunk_counts = chunk_counts;
+        this->count_vector = count_vector;
+    }
+    count_task * svc(count_task * task){
+        Timer timer;
+        timer.start("freq_join_overhead");
+        auto &counts = (*chunk_counts)[task->chunk];
+        for(int c=0; c<256; c++){
+            (*count_vector)[c] += counts[c];
+        }
+        join_time += timer.stop();
+        return GO_ON;
+    }
+    long getJoinTime(){return join_time;}
+};
 
-int main(int argc, char* argv[]){
+/**
+ * @brief number of tasks each queue of the encoding pipeline can hold
+ * 
+ */
+const int ENCODE_QUEUE_LENGTH = 2;
+
+/**
+ * @brief type of the tasks of the encoding pipeline, one for each chunk
+ * 
+ */
+typedef struct{
+    int chunk;
+    // encoding of the chunk, with the header of the chunk at its start unless the bitstream is contiguous
+    vector<char> buffer;
+    long encode_time;
+    // characters of the chunk, only read by the first stage with positional reads and released once encoded
+    std::unique_ptr<unsigned char[]> input;
+} encode_task;
 
-    std::mutex m;
-    std::condition_variable cv;
-
-    string filename = "";
-    string output_filename = "";
-    int n_threads = 4;
-    bool verbose = false;
-    string log_folder = "";
-
-    // used to log parallel frequency count without including time spent reading from file
-    bool debug = false;
-
-    // parse command line arguments
-    int opt;
-
-    while ((opt = getopt(argc, argv, "hi:o:t:vl:d")) != -1) {
-        switch (opt) {
-        case 'h':
-            print_help();
-            return 1;
-        case 'i':
-            filename = optarg;
-            break;
-        case 'o':
-            output_filename = optarg;
-            break;
-        case 't':
-            n_threads = atoi(optarg);
-            break;
-        case 'v':
-            verbose = true;
-            break;
-        case 'l':
-            log_folder = optarg;
-            break;
-        case 'd':
-            debug = true;
-            break;
-        default:
-            print_help();
-            return 0;
+/**
+ * @brief first stage of the encoding pipeline
+ * 
+ * Sends a task for each chunk in order. Mapped chunks are encoded from their views, with positional reads
+ * each chunk is read again into the task, as when encoding in blocks. The queues are bounded, so the emitter
+ * waits when they are full and only the chunks in the queues are in memory.
+ * 
+ */
+class ChunkEmitter : public ff_node_t<encode_task>{
+private:
+    int n_chunks;
+    vector<shared_ptr<file_span>> file_chunks;
+    shared_ptr<InputFile> input;
+    uint64_t chunk_size;
+    bool read_ok = true;
+    long read_time = 0;
+public:
+    ChunkEmitter(int n_chunks, vector<shared_ptr<file_span>> file_chunks, shared_ptr<InputFile> input, uint64_t chunk_size){
+        this->n_chunks = n_chunks;
+        this->file_chunks = file_chunks;
+        this->input = input;
+        this->chunk_size = chunk_size;
+    }
+    encode_task * svc(encode_task * in){
+        Timer timer;
+        for(int i=0; i<n_chunks; i++){
+            auto task = new encode_task{i, {}, 0, nullptr};
+            if(input != nullptr){
+                timer.start("reading");
+                task->input.reset(new unsigned char[file_chunks[i]->size]);
+                read_ok = input->read(i * chunk_size, file_chunks[i]->size, task->input.get());
+                read_time += timer.stop();
+                // the chunks after a failed read are not sent
+                if(!read_ok){
+                    error("reading chunk\n");
+                    delete task;
+                    break;
+                }
+            }
+            ff_send_out(task);
         }
+        return EOS;
     }
+    bool getReadOk(){return read_ok;}
+    long getReadTime(){return read_time;}
+};
 
-    // fail if debug was enabled without logging enabled as well
-    if(debug && log_folder == ""){
-        cout << "Debug mode cannot be enabled without logging enabled." << endl;
-        print_help();
-        return 0;
+/**
+ * @brief worker node of the farm encoding the chunks
+ * 
+ * The exact size of the encoding of a chunk is known from its character counts, so its buffer is allocated once.
+ * For a contiguous bitstream each chunk is encoded starting from its bit offset in the first byte, leaving the
+ * bits of the previous chunk to 0.
+ * When the output file is mapped in memory each chunk is encoded in place and its buffer is left empty.
+ * 
+ */
+class encodeTask : public ff_node_t<encode_task>{
+private:
+    vector<shared_ptr<file_span>> file_chunks;
+    shared_ptr<vector<vector<uint64_t>>> chunk_counts;
+    const BitWriter *writer;
+    FileHeader *header;
+    const vector<uint64_t> *bit_offsets;
+    size_t chunk_header_size;
+    char *mapped_output;
+    const vector<uint64_t> *chunk_offsets;
+    int cpu;
+public:
+    encodeTask(vector<shared_ptr<file_span>> file_chunks, shared_ptr<vector<vector<uint64_t>>> chunk_counts,
+            const BitWriter *writer, FileHeader *header, const vector<uint64_t> *bit_offsets, size_t chunk_header_size,
+            char *mapped_output, const vector<uint64_t> *chunk_offsets, int cpu){
+        this->file_chunks = file_chunks;
+        this->chunk_counts = chunk_counts;
+        this->writer = writer;
+        this->header = header;
+        this->bit_offsets = bit_offsets;
+        this->chunk_header_size = chunk_header_size;
+        this->mapped_output = mapped_output;
+        this->chunk_offsets = chunk_offsets;
+        this->cpu = cpu;
     }
-    // fail if input file does not exist or is missing
-    if((filename == "" || !std::filesystem::exists(filename))){
-        cout << "Input filename is missing or file does not exist." << endl;
-        print_help();
+    int svc_init(){
+        // -1 means that the worker is not pinned
+        if(cpu >= 0){
+            CpuTopology::pin(cpu);
+        }
         return 0;
     }
-    // fail if no output file was given without debug enabled
-    if((output_filename == "" && !debug)){
-        cout << "Output filename is required." << endl;
-        print_help();
+    encode_task * svc(encode_task * task){
+        Timer timer;
+        timer.start("encode");
+        int i = task->chunk;
+        auto &file_chunk = file_chunks[i];
+        const unsigned char *data = task->input != nullptr ? task->input.get() : file_chunk->data;
+        // bit_offsets is only given for a contiguous bitstream
+        if(bit_offsets != nullptr){
+            uint64_t start_bit = (*bit_offsets)[i];
+            uint64_t end_bit = (*bit_offsets)[i+1];
+            int skip = start_bit % 8;
+            task->buffer.resize(BitWriter::buffer_size(end_bit - start_bit + skip));
+            writer->encode(data, file_chunk->size, task->buffer.data(), skip);
+            // only the bytes touched by the chunk are kept
+            task->buffer.resize((end_bit + 7) / 8 - start_bit / 8);
+        }
+        else{
+            // chunks which would not shrink are stored raw
+            uint64_t n_bits = writer->encoded_bits((*chunk_counts)[i]);
+            bool raw = header->storeRaw(n_bits, file_chunk->size);
+            // the next chunk follows in the mapping, so only the bytes of the encoding are written
+            char *output;
+            if(mapped_output != nullptr){
+                output = mapped_output + (*chunk_offsets)[i];
+            }
+            else{
+                task->buffer.resize(chunk_header_size + (raw ? file_chunk->size : BitWriter::buffer_size(n_bits)));
+                output = task->buffer.data();
+            }
+            if(raw){
+                std::copy(data, data + file_chunk->size, output + chunk_header_size);
+            }
+            else{
+                n_bits = writer->encode(data, file_chunk->size, output + chunk_header_size, 0, mapped_output != nullptr);
+            }
+            uint64_t chunk_size = raw ? file_chunk->size : BitWriter::byte_size(n_bits);
+            // write size of chunk and number of padding bits, and the checksum of the chunk while it is in cache
+            auto chunk_header = header->serializeChunk(chunk_size, raw ? FileHeader::RAW_CHUNK : BitWriter::padding(n_bits), nullptr, 0,
+                                                        output + chunk_header_size);
+            std::copy(chunk_header.begin(), chunk_header.end(), output);
+            if(mapped_output == nullptr){
+                task->buffer.resize(chunk_header_size + chunk_size);
+            }
+        }
+        task->input.reset();
+        task->encode_time = timer.stop();
+        return task;
+    }
+};
+
+/**
+ * @brief last stage of the encoding pipeline
+ * 
+ * Receives the encoded chunks in order and writes them one after the other.
+ * For a contiguous bitstream the last byte of a chunk is shared with the next one if it is not full,
+ * so it is kept and merged with the first byte of the next chunk.
+ * With an asynchronous writer the chunk is copied in one of its buffers and the writer is not waited for.
+ * 
+ */
+class ChunkWriter : public ff_node_t<encode_task>{
+private:
+    OutputFile *output_file;
+    AsyncWriter *async_writer;
+    uint64_t offset;
+    int n_chunks;
+    const vector<uint64_t> *bit_offsets;
+    // last byte of the previous chunk of a contiguous bitstream, if not written yet
+    char pending = 0;
+    bool write_ok = true;
+    long encode_time = 0;
+    long write_time = 0;
+public:
+    ChunkWriter(OutputFile *output_file, AsyncWriter *async_writer, uint64_t offset, int n_chunks, const vector<uint64_t> *bit_offsets){
+        this->output_file = output_file;
+        this->async_writer = async_writer;
+        this->offset = offset;
+        this->n_chunks = n_chunks;
+        this->bit_offsets = bit_offsets;
+    }
+    encode_task * svc(encode_task * task){
+        Timer timer;
+        timer.start("write");
+        int i = task->chunk;
+        size_t n_bytes = task->buffer.size();
+        if(bit_offsets != nullptr){
+            if((*bit_offsets)[i] % 8 != 0){
+                task->buffer[0] |= pending;
+            }
+            if((*bit_offsets)[i+1] % 8 != 0 && i != n_chunks - 1){
+                pending = task->buffer[--n_bytes];
+            }
+        }
+        // when debugging there is no output file
+        if(async_writer != nullptr){
+            char *buffer = async_writer->acquire(offset);
+            std::copy(task->buffer.begin(), task->buffer.begin() + n_bytes, buffer);
+            async_writer->submit(buffer, n_bytes, offset);
+        }
+        else if(output_file->is_open() && write_ok){
+            write_ok = output_file->write(offset, task->buffer.data(), n_bytes);
+        }
+        offset += n_bytes;
+        encode_time += task->encode_time;
+        write_time += timer.stop();
+        delete task;
+        return GO_ON;
+    }
+    bool getWriteOk(){return write_ok;}
+    long getEncodeTime(){return encode_time;}
+    long getWriteTime(){return write_time;}
+};
+
+/**
+ * @brief function encoding the standard input or writing to the standard output
+ *
+ * The stream is split in blocks with their own codes, encoded by the threads of PipeEncoder and written in order,
+ * the same encoding written by the other versions.
+ *
+ * @param options options of the encoder
+ * @param logger logger the times are added to
+ * @return int 0 if the stream was encoded, -1 otherwise
+ */
+int encode_stream(const EncoderOptions &options, Logger &logger){
+    long elapsed_time;
+
+    // messages go to the standard error when the encoding is written to the standard output
+    std::ostream &info = options.output_filename == "-" ? clog : cout;
+    PipeEncoder encoder(options.filename, options.output_filename, FileHeader::DEFAULT_CHUNK_CHARS, options.n_threads,
+                        options.latency == -1 ? PipeEncoder::DEFAULT_LATENCY : options.latency, options.max_code_length);
+    FileHeader header(FileHeader::DEFAULT_CHUNK_CHARS);
+    header.setChecksums(options.checksums);
+
+    // the preloaded codes are built from all the characters of the file, counted in blocks
+    if(options.preload_filename != ""){
+        logger.start("preload");
+            vector<uint64_t> preload_counts;
+            StreamEncoder preload_stream(options.preload_filename, FileHeader::DEFAULT_CHUNK_CHARS, options.n_threads);
+            bool ok = preload_stream.count(preload_counts);
+            HuffmanTree preload_ht(preload_counts, options.max_code_length);
+            encoder.preload(preload_ht.getCodeLengths());
+        elapsed_time = logger.stop();
+        if(!ok){
+            info << "Could not read the file to build the preloaded codes from." << endl;
+            return -1;
+        }
+        if(options.verbose){
+            info << "Building the preloaded codes took " << elapsed_time << " usecs." << endl;
+        }
+    }
+
+    // single pass over the stream, blocks are written in order as soon as they are encoded
+    logger.start("encode_and_write");
+        bool ok = encoder.encode(header);
+    elapsed_time = logger.stop();
+    logger.add_stat("reading_input", encoder.getReadTime());
+    logger.add_stat("freq_time", encoder.getFreqTime());
+    logger.add_stat("encode", encoder.getEncodeTime());
+    logger.add_stat("write", encoder.getWriteTime());
+    logger.add_stat("max_delay", encoder.getMaxDelay());
+
+    if(!ok){
+        info << "Could not encode input stream." << endl;
+        return -1;
+    }
+    if(options.verbose){
+        info << "Reading, counting, encoding and writing the stream took " << elapsed_time << " usecs." << endl;
+        info << encoder.getNTables() << " tables of codes were written for " << encoder.getNBlocks() << " blocks of "
+             << encoder.getNChars() << " characters in total." << endl;
+        info << "The longest time from the arrival of a block to the end of its write was " << encoder.getMaxDelay() << " usecs." << endl;
+        encoder.getLimitReport().print(info, options.max_code_length);
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char* argv[]){
+
+    // a single file is encoded in chunks, or a stream in blocks with their own codes, options about batches and
+    // blocks of a file are not accepted
+    EncoderOptions options("hi:o:t:vl:dLm:pcA:uDMF:P:k");
+    int exit_code;
+    if(!options.parse(argc, argv, exit_code)){
+        return exit_code;
+    }
+    // with positional reads, reading and counting happen in the same node and cannot be timed separately
+    if(options.debug && options.positional){
+        cout << "Debug mode cannot be enabled with positional reads." << endl;
+        options.print_help();
         return 0;
     }
 
+    // the placement was checked when parsing the options
+    vector<int> worker_cpus;
+    CpuTopology().placement(options.affinity, options.n_threads, worker_cpus);
+
     // build path to save logs
     // assumes input file ends in 3 letter long file format e.g. .txt
-    string log_file = "./" + log_folder + "/ff/" + std::to_string(n_threads) + "_" + filename;
+    // the standard input is logged as stdin
+    string log_file = "./" + options.log_folder + "/ff/" + std::to_string(options.n_threads) + "_"
+                        + (options.filename == "-" ? "stdin.csv" : options.filename);
     log_file = log_file.substr(0, log_file.find_last_of('.'))+".csv";
 
-    Logger logger(log_file, n_threads);
+    Logger logger(log_file, options.n_threads);
     Timer timer;
     long elapsed_time; 
     Timer tot_timer;
 
     tot_timer.start("total");
-    write_id=0;
 
-    // vector of pointers to vectors storing partial character counts
-    vector<shared_ptr<vector<int>>> partial_counts(n_threads);
-    // initialize vectors
-    for(int i=0; i<partial_counts.size(); i++){
-        partial_counts[i] = std::make_shared<vector<int>>(256);
+    // a stream has no known size to split in chunks, it is read, encoded and written in order by PipeEncoder
+    if(options.streaming){
+        int ret = encode_stream(options, logger);
+        if(ret != 0){
+            return ret;
+        }
+        logger.add_stat("total", tot_timer.stop());
+        if(options.log_folder != ""){
+            std::filesystem::create_directory("./" + options.log_folder);
+            std::filesystem::create_directory("./" + options.log_folder + "/ff");
+            logger.write_logs(log_file);
+        }
+        return 0;
     }
 
     // vector to store final character counts
-    vector<int> count_vector(256);
-    // time to read file, including the resizing of the buffer
+    vector<uint64_t> count_vector(256);
+    // time to map the file and split it in chunks
     shared_ptr<long> read_time(new long);
+
+    // by default the file is mapped in memory and each worker works on views of its chunks, so nothing is copied
+    // with positional reads each worker reads its own chunks into a buffer which is not initialized, and the chunks
+    // are read again while encoding, so that only the chunks in the queues of the pipeline are in memory
+    shared_ptr<MappedFile> file;
+    shared_ptr<InputFile> input;
+    bool open;
+    if(options.positional){
+        input = std::make_shared<InputFile>(options.filename);
+        open = input->is_open();
+    }
+    else{
+        file = std::make_shared<MappedFile>(options.filename);
+        open = file->is_open();
+    }
+    if(!open){
+        cout << "Could not read input file." << endl;
+        return -1;
+    }
+
+    // the file is split in chunks of a fixed size, which do not depend on the number of threads
+    // the legacy header only describes chunks of even length, so their size depends on the file
+    int n_chunks = std::max(uint64_t(1), (options.filesize + FileHeader::DEFAULT_CHUNK_CHARS - 1) / FileHeader::DEFAULT_CHUNK_CHARS);
+    uint64_t chunk_size = options.header_version >= FileHeader::CANONICAL_64 ? FileHeader::DEFAULT_CHUNK_CHARS : options.filesize / n_chunks;
+    // no point in having more workers than chunks
+    int n_workers = std::min(options.n_threads, n_chunks);
+
+    // character counts of each chunk, used to compute the size of its encoding
+    // the vectors are allocated by the workers, so that they are on the memory node of their CPU
+    auto chunk_counts = std::make_shared<vector<vector<uint64_t>>>(n_chunks);
+    // descriptors of the chunks sent to the counting farm
+    auto count_tasks = std::make_shared<vector<count_task>>(n_chunks);
     
-    // vector storing the file in chunks
-    vector<shared_ptr<vector<unsigned char>>> file_chunks(n_threads);
+    // vector storing the views of the chunks of the file
+    vector<shared_ptr<file_span>> file_chunks(n_chunks);
     for(int i=0; i<file_chunks.size(); i++){
-        file_chunks[i] = std::make_shared<vector<unsigned char>>();
+        uint64_t read_size = i == n_chunks - 1 ? options.filesize - i * chunk_size : chunk_size;
+        file_chunks[i] = std::make_shared<file_span>(file_span{nullptr, read_size});
     }
 
     // vector to store execution times
-    shared_ptr<vector<long>> freq_time_vec (new vector<long>(n_threads));
+    shared_ptr<vector<long>> freq_time_vec (new vector<long>(n_workers));
+    shared_ptr<vector<long>> read_time_vec (new vector<long>(n_workers));
 
-    if(debug){timer.start("read_and_count");}
+    if(options.debug){timer.start("read_and_count");}
     else{logger.start("read_and_count");}
-        // build and run farm to count characters
-        Reader read_node(n_threads, file_chunks, filename, read_time, debug);
+        // build and run farm to count characters, chunks are sent to the workers as soon as they are free
+        // the counts of each chunk are added to the counts of the file by the collector as soon as they are ready
+        Reader read_node(chunk_size, file_chunks, file, read_time, count_tasks, options.debug);
+        CountCollector count_node(chunk_counts, &count_vector);
         vector<std::unique_ptr<ff_node>> workers;
-        for(int i=0; i<n_threads; i++){
-            workers.push_back(make_unique<freqTask>(partial_counts[i], file_chunks[i], freq_time_vec));
+        for(int i=0; i<n_workers; i++){
+            workers.push_back(make_unique<freqTask>(chunk_counts, file_chunks, freq_time_vec, input,
+                                chunk_size, read_time_vec, i, worker_cpus.empty() ? -1 : worker_cpus[i]));
         }
-        ff_Farm<freqTask> freq_farm(move(workers), read_node);
-        freq_farm.remove_collector();            
+        ff_Farm<freqTask> freq_farm(move(workers), read_node, count_node);
+        freq_farm.set_scheduling_ondemand();
+        // workers pin themselves according to the chosen placement
+        freq_farm.no_mapping();
         if (freq_farm.run_and_wait_end()<0) {
             error("running farm\n");
             return -1;
         }
-    if(debug){
+    if(options.debug){
         elapsed_time = timer.stop();
         logger.add_stat("freq_time", elapsed_time - *read_time);
         logger.add_stat("read_and_count", elapsed_time);
     }
     else{elapsed_time = logger.stop();}
-    
-    // join partial character counts
-    timer.start("freq_join_overhead");
-    for(auto &c : partial_counts){
-        for(int i=0; i<c->size(); i++)
-        {
-            count_vector[i] += (*c)[i];
+
+    // with positional reads the time spent reading is the one of the workers
+    for(auto &t : (*read_time_vec)){
+        if(t < 0){
+            cout << "Could not read input file." << endl;
+            return -1;
         }
+        *read_time += t;
     }
-    long freq_join_overhead = timer.stop();
+    
+    // the counts were joined by the collector while the workers were counting
+    long freq_join_overhead = count_node.getJoinTime();
         
 
     long freq_time = 0;
@@ -261,162 +639,169 @@ int main(int argc, char* argv[]){
     }
 
     logger.add_stat("reading_input", *read_time);
-    if(!debug){logger.add_stat("freq_time", freq_time);}
+    if(!options.debug){logger.add_stat("freq_time", freq_time);}
     logger.add_stat("freq_join_overhead", freq_join_overhead);
 
-    if(verbose){
+    if(options.verbose){
         cout << "Reading input and counting character frequency took " << elapsed_time << " real usecs." << endl;
         cout << "Reading input took " << *read_time << " usecs." << endl;
         cout << "Counting characters took " << freq_time << " usecs in overall computation time between threads." << endl;
-        cout << "Joining partial frequency counts took " << freq_join_overhead << " usecs." << endl;
+        cout << "Joining the counts of the chunks took " << freq_join_overhead << " usecs in the collector." << endl;
     }
     
     // create the huffman tree and table of encodings
     logger.start("huffman_tree_creation");
-        HuffmanTree ht(count_vector);
+        HuffmanTree ht(count_vector, options.max_code_length);
     elapsed_time = logger.stop();
 
-    if(verbose){
+    if(options.verbose){
         cout << "Creating the Huffman tree and extracting the code table took " << elapsed_time << " usecs." << endl;
+        // compare with the unrestricted codes to report the loss in compression
+        LengthLimitReport limit_report;
+        limit_report.add(ht, count_vector);
+        limit_report.print(cout, options.max_code_length);
     }
 
-    auto code_table = ht.getCodes();
+    // header of the encoded file, the codes used depend on its version
+    // a contiguous bitstream is stored as a single chunk, as in the sequential version
+    FileHeader header(options.header_version, options.contiguous ? 1 : n_chunks, count_vector, ht,
+                        options.header_version >= FileHeader::CANONICAL_64 && !options.contiguous ? chunk_size : 0);
+    header.setChecksums(options.checksums);
+    auto code_table = header.getCodes();
+    BitWriter writer(code_table);
 
     long encode_time = 0;
     long write_time = 0;
 
-    vector<long> write_time_vec(n_threads);
-    vector<long> encode_time_vec(n_threads);
-
     // encode and write to file in chunks
     logger.start("encode_and_write");
-        // write to file the metadata necessary to decode:
-        // number of chunks, and the table of character frequencies
-        std::ofstream output_file(output_filename, std::ios::binary);  
+        timer.start("write");
+        // metadata necessary to decode:
+        // number of chunks, and the table of encodings
+        auto header_buf = header.serialize();
+
+        size_t chunk_header_size = header.serializeChunk(0, 0).size();
+        // position of each chunk in the bitstream, only used for a contiguous bitstream
+        vector<uint64_t> bit_offsets(n_chunks + 1, 0);
+        vector<char> bitstream_header;
+        if(options.contiguous){
+            for(int i=0; i<n_chunks; i++){
+                bit_offsets[i+1] = bit_offsets[i] + writer.encoded_bits((*chunk_counts)[i]);
+            }
+            uint64_t n_bits = bit_offsets[n_chunks];
+            bitstream_header = header.serializeChunk(BitWriter::byte_size(n_bits), BitWriter::padding(n_bits));
+        }
 
+        // when the output file is mapped in memory it is only created by the mapping, with its final size
+        OutputFile output_file(options.mapped ? "" : options.output_filename);
+        bool write_ok = true;
         if(output_file.is_open()){
-            timer.start("write");
-                output_file.write(reinterpret_cast<const char *>(&n_threads), sizeof(n_threads));
-                for(auto &f : count_vector){
-                    output_file.write(reinterpret_cast<const char *>(&f), sizeof(f));
-                }
-            write_time += timer.stop();
+            write_ok = output_file.write(0, header_buf.data(), header_buf.size())
+                        && output_file.write(header_buf.size(), bitstream_header.data(), bitstream_header.size());
         }
-        // lambda function to encode and write a chunk of file
-        auto encode_chunk = [&m, &cv, &file_chunks, &code_table, &encode_time_vec, &write_time_vec, &output_file](int i) {
-            Timer timer_encode;
-            timer_encode.start("encode");
-
-           // not reserving space here slows down code considerably because of the reallocations needed
-            vector<char> buffer_vec;
-            buffer_vec.reserve(file_chunks[i]->size()*2/3);
-
-            // current size of the buffer
-            int buf_len = 0;
-            char buffer = 0;
-            // remaining bits to save to buffer for currently considered character
-            // is initialized with the length of the encoding for each character
-            int remaining;
-            // code of the character, stored as an int
-            int code;
-            // size of a single buffer
-            const int max_size = sizeof(char) * 8;
-
-            // actual encoding of the file
-            // encoding is stored into a vector of chars
-            for(auto &c : *(file_chunks)[i]){
-                auto code_pair = code_table[int(c)];
-                code = code_pair.second;
-                remaining = code_pair.first;;
-
-                // loop saving the encoding of the character to the buffer
-                while(remaining != 0){
-                    // buffer has reached maximum size
-                    if(buf_len==max_size){
-                        // flush buffer to vector
-                        buffer_vec.push_back(buffer);
-                        // reset buffer
-                        buffer = 0;
-                        buf_len = 0;
-                    }
-                    // buffer has enough space to store the rest of the encoding
-                    // of the current character
-                    if(buf_len+remaining <= max_size){
-                        // shift buffer and add code to the end
-                        buffer = (buffer << remaining) | code;
-                        //update buffer size
-                        buf_len += remaining;
-                        remaining = 0;
-                    }
-                    // buffer does not have enough space to store the rest of the encoding
-                    // of the current character 
-                    else{
-                        int shift = max_size-buf_len;
-                        // shift buffer to left and shift encoding to right
-                        buffer = (buffer << shift) | (code >> (remaining - shift));
-                        remaining -= shift;
-                        buf_len = max_size;
-                    }
-                }
+        std::unique_ptr<MappedOutputFile> mapped_output;
+        vector<uint64_t> chunk_offsets;
+        if(options.mapped && options.output_filename != ""){
+            chunk_offsets.assign(n_chunks + 1, header_buf.size());
+            for(int i=0; i<n_chunks; i++){
+                chunk_offsets[i+1] = chunk_offsets[i] + chunk_header_size
+                                    + header.storedSize(writer.encoded_bits((*chunk_counts)[i]), file_chunks[i]->size);
             }
-            // flush buffer if necessary and add padding bits to the end
-            if(buf_len!=0){
-                buffer_vec.push_back(buffer << (max_size-buf_len));
+            mapped_output = std::make_unique<MappedOutputFile>(options.output_filename, chunk_offsets[n_chunks]);
+            write_ok = mapped_output->is_open();
+            if(write_ok){
+                std::copy(header_buf.begin(), header_buf.end(), mapped_output->data());
             }
-            encode_time_vec[i] = timer_encode.stop();
-
-            int chunk_size = buffer_vec.size();
-            char padding = max_size-buf_len;
-
-            if(output_file.is_open()){
-                // wait until the chunk of the thread can be written
-                std::unique_lock lk(m);
-                while(i != write_id){
-                    cv.wait(lk);
-                }
-                timer_encode.start("write");
-                // write size of chunk
-                output_file.write(reinterpret_cast<const char *>(&chunk_size), sizeof(chunk_size));
-                // write number of padding bits
-                output_file.write(&padding, 1);
-                // write the encoded binary
-                output_file.write(buffer_vec.data(), buffer_vec.size());
-
-                write_time_vec[i] =  timer_encode.stop();;
-                write_id++;
-                cv.notify_all();
+        }
+        char *mapped_data = write_ok && mapped_output != nullptr ? mapped_output->data() : nullptr;
+
+        // buffers of the asynchronous writer must hold the largest encoded chunk
+        std::unique_ptr<AsyncWriter> async_writer;
+        if(options.async && output_file.is_open()){
+            size_t max_buffer = 0;
+            for(int i=0; i<n_chunks; i++){
+                max_buffer = std::max(max_buffer, options.contiguous ?
+                                size_t((bit_offsets[i+1] + 7) / 8 - bit_offsets[i] / 8) :
+                                chunk_header_size + header.storedSize(writer.encoded_bits((*chunk_counts)[i]), file_chunks[i]->size));
             }
-            return;
-        };
-
-        ParallelFor encode_pf(n_threads);
+            async_writer = std::make_unique<AsyncWriter>(output_file, options.output_filename, 2 * ENCODE_QUEUE_LENGTH, max_buffer, options.direct);
+        }
+        write_time += timer.stop();
 
-        encode_pf.parallel_for_static(0, n_threads, 1, 0, encode_chunk, n_threads);
+        // build and run the pipeline encoding the chunks, they are encoded by the farm in any order
+        // and written in order by the last stage
+        ChunkEmitter emit_node(n_chunks, file_chunks, input, chunk_size);
+        vector<std::unique_ptr<ff_node>> encoders;
+        for(int i=0; i<n_workers; i++){
+            encoders.push_back(make_unique<encodeTask>(file_chunks, chunk_counts, &writer, &header,
+                                options.contiguous ? &bit_offsets : nullptr, chunk_header_size, mapped_data, &chunk_offsets,
+                                worker_cpus.empty() ? -1 : worker_cpus[i]));
+        }
+        ff_OFarm<encode_task> encode_farm(move(encoders));
+        encode_farm.no_mapping();
+        // bounded queues limit the number of encoded chunks in memory, the emitter waits when they are full
+        encode_farm.setFixedSize(true);
+        encode_farm.setInputQueueLength(ENCODE_QUEUE_LENGTH, true);
+        encode_farm.setOutputQueueLength(ENCODE_QUEUE_LENGTH, true);
+        ChunkWriter write_node(&output_file, async_writer.get(), header_buf.size() + bitstream_header.size(), n_chunks,
+                                options.contiguous ? &bit_offsets : nullptr);
+        ff_Pipe<encode_task> encode_pipe(emit_node, encode_farm, write_node);
+        encode_pipe.setFixedSize(true);
+        encode_pipe.setXNodeInputQueueLength(ENCODE_QUEUE_LENGTH, true);
+        if(encode_pipe.run_and_wait_end()<0){
+            error("running pipeline\n");
+            return -1;
+        }
+        write_ok = write_ok && write_node.getWriteOk();
+        bool read_ok = emit_node.getReadOk();
+        encode_time = write_node.getEncodeTime();
+        write_time += write_node.getWriteTime();
+
+        // the last stage only queued the writes, the time spent waiting for them is reported separately
+        long write_wait = 0;
+        if(async_writer != nullptr){
+            timer.start("write_wait");
+            write_ok = async_writer->finish() && write_ok;
+            write_wait = timer.stop();
+        }
 
     elapsed_time = logger.stop();
-    for(auto &t : encode_time_vec){
-        encode_time += t;
-    }
 
-    for(auto &t : write_time_vec){
-        write_time += t;
+    if(!read_ok){
+        cout << "Could not read input file." << endl;
+        return -1;
+    }
+    if(!write_ok){
+        cout << "Could not write output file." << endl;
+        return -1;
     }
     
+    // the chunks read again while encoding, only with positional reads
+    if(input != nullptr){logger.add_stat("reading_input", emit_node.getReadTime());}
     logger.add_stat("write", write_time);
-    if(!debug){logger.add_stat("encode", encode_time);}
+    if(!options.debug){logger.add_stat("encode", encode_time);}
     else{logger.add_stat("encode", elapsed_time);}
+    if(async_writer != nullptr){logger.add_stat("write_wait", write_wait);}
 
-    if(verbose){
+    if(options.verbose){
         cout << "Encoding and writing the file took " << elapsed_time << " usecs." << endl;
         cout << "Encoding the file took " << encode_time << " usecs." << endl;
+        if(input != nullptr){
+            cout << "Reading input again while encoding took " << emit_node.getReadTime() << " usecs." << endl;
+        }
         cout << "Writing encoded file took " << write_time << " usecs." << endl;
+        if(async_writer != nullptr){
+            cout << "Waiting for the asynchronous writes took " << write_wait << " usecs (io_uring: "
+                 << (async_writer->isAsync() ? "yes" : "no") << ", registered buffers: " << (async_writer->isRegistered() ? "yes" : "no")
+                 << ", direct: " << (async_writer->isDirect() ? "yes" : "no") << ")." << endl;
+        }
     }
 
     logger.add_stat("total", tot_timer.stop());
 
-    if(log_folder != ""){
-        std::filesystem::create_directory("./" + log_folder);
-        std::filesystem::create_directory("./" + log_folder + "/ff");
+    if(options.log_folder != ""){
+        std::filesystem::create_directory("./" + options.log_folder);
+        std::filesystem::create_directory("./" + options.log_folder + "/ff");
         logger.write_logs(log_file);
     }
     return 0;
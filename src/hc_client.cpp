@@ -0,0 +1,225 @@
+/**
+ * @file hc_client.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the client sending compression and decompression requests to hc_server
+ * @date 2026-10-18
+ *
+ * The descriptors of the input and of the output are passed to the server, which reads and writes them directly.
+ * With shared memory the client copies the input to a memory file and reads the result from another one, as a
+ * program producing its data in memory would do. Requests can be repeated to measure their latency.
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "logger.hpp"
+#include "huffman_service.hpp"
+#include "input_file.hpp"
+#include "output_file.hpp"
+
+using std::cout, std::endl, std::string, std::vector;
+
+void print_help(){
+    cout << "The program accepts the following arguments:" << endl;
+    cout << "\t -i path: path to the file to be encoded or decoded, required unless stopping the server." << endl;
+    cout << "\t -o path: path where the result has to be saved, required unless stopping the server." << endl;
+    cout << "\t -s path: path of the socket of the server, default " << HuffmanService::DEFAULT_SOCKET << "." << endl;
+    cout << "\t -d: decode the file instead of encoding it." << endl;
+    cout << "\t -S: pass the data in shared memory files instead of passing the files themselves." << endl;
+    cout << "\t -n number: number of times the request is sent, default 1." << endl;
+    cout << "\t -v: set verbose, prints the percentiles of the latency of the requests." << endl;
+    cout << "\t -q: ask the server to stop." << endl;
+}
+
+/**
+ * @brief function sending a request to the server and waiting for its reply
+ *
+ * @param sock descriptor of the socket connected to the server
+ * @param request request to send
+ * @param fds descriptors to pass with the request
+ * @param n_fds number of descriptors to pass
+ * @param reply where to store the reply
+ * @return true if the reply was received
+ * @return false otherwise
+ */
+bool send_request(int sock, service_request &request, const int *fds, int n_fds, service_reply &reply){
+    if(!HuffmanService::send_message(sock, &request, sizeof(request), fds, n_fds)){
+        return false;
+    }
+    int reply_fds[1];
+    int n_reply_fds;
+    ssize_t size = HuffmanService::receive_message(sock, &reply, sizeof(reply), reply_fds, 0, n_reply_fds);
+    return size == sizeof(reply) && reply.id == request.id;
+}
+
+int main(int argc, char* argv[]){
+
+    string filename = "";
+    string output_filename = "";
+    string socket_path = HuffmanService::DEFAULT_SOCKET;
+    bool decode = false;
+    bool shared_memory = false;
+    int n_requests = 1;
+    bool verbose = false;
+    bool stop = false;
+
+    // parse command line arguments
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hi:o:s:dSn:vq")) != -1) {
+        switch (opt) {
+        case 'h':
+            print_help();
+            return 1;
+        case 'i':
+            filename = optarg;
+            break;
+        case 'o':
+            output_filename = optarg;
+            break;
+        case 's':
+            socket_path = optarg;
+            break;
+        case 'd':
+            decode = true;
+            break;
+        case 'S':
+            shared_memory = true;
+            break;
+        case 'n':
+            n_requests = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'q':
+            stop = true;
+            break;
+        default:
+            print_help();
+            return 0;
+        }
+    }
+
+    if(!stop && ((filename == "") || !std::filesystem::exists(filename) || (output_filename == ""))){
+        cout << "Input and output filenames are required or input file does not exist." << endl;
+        print_help();
+        return 0;
+    }
+    if(n_requests <= 0){
+        cout << "Number of requests must be positive." << endl;
+        print_help();
+        return 0;
+    }
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if(socket_path == "" || socket_path.size() >= sizeof(addr.sun_path)){
+        cout << "Path of the socket must be shorter than " << sizeof(addr.sun_path) << " characters." << endl;
+        print_help();
+        return 0;
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(sock < 0 || connect(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0){
+        cout << "Could not connect to the server on " << socket_path << "." << endl;
+        return -1;
+    }
+
+    service_request request = {HuffmanService::SHUTDOWN, 0, 0};
+    service_reply reply;
+    if(stop){
+        if(!send_request(sock, request, nullptr, 0, reply)){
+            cout << "The server did not reply." << endl;
+            return -1;
+        }
+        close(sock);
+        return 0;
+    }
+
+    // the input and output passed to the server, in shared memory the input is copied to a memory file
+    int fds[2];
+    InputFile input(filename);
+    if(!input.is_open()){
+        cout << "Could not open input file." << endl;
+        return -1;
+    }
+    if(shared_memory){
+        // the server only maps an input which can no longer shrink or change
+        fds[0] = memfd_create("hc_input", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        fds[1] = memfd_create("hc_output", MFD_CLOEXEC);
+        vector<unsigned char> buffer(input.size());
+        if(fds[0] < 0 || fds[1] < 0 || !input.read(0, input.size(), buffer.data())
+                || write(fds[0], buffer.data(), buffer.size()) != ssize_t(buffer.size())
+                || fcntl(fds[0], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) != 0){
+            cout << "Could not copy the input to shared memory." << endl;
+            return -1;
+        }
+    }
+    else{
+        fds[0] = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        fds[1] = open(output_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(fds[0] < 0 || fds[1] < 0){
+            cout << "Could not open input or output file." << endl;
+            return -1;
+        }
+    }
+
+    request.op = decode ? HuffmanService::DECOMPRESS : HuffmanService::COMPRESS;
+    vector<long> latencies;
+    vector<long> service_times;
+    Timer timer;
+    for(int i=0; i<n_requests; i++){
+        request.id = i;
+        timer.start("request");
+        if(!send_request(sock, request, fds, 2, reply)){
+            cout << "The server did not reply." << endl;
+            return -1;
+        }
+        latencies.push_back(timer.stop());
+        service_times.push_back(reply.service_time);
+        if(reply.status != HuffmanService::OK){
+            cout << "Request failed: " << HuffmanService::status_string(reply.status) << "." << endl;
+            return -1;
+        }
+    }
+    close(sock);
+
+    // the server writes from the start of the output, which may have been longer before
+    if(ftruncate(fds[1], reply.output_size) != 0){
+        cout << "Could not resize output file." << endl;
+        return -1;
+    }
+    if(shared_memory){
+        OutputFile output_file(output_filename);
+        // empty outputs cannot be mapped, the output file is just created
+        void *mapping = reply.output_size > 0 ? mmap(nullptr, reply.output_size, PROT_READ, MAP_SHARED, fds[1], 0) : nullptr;
+        if(mapping == MAP_FAILED || !output_file.is_open()
+                || (mapping != nullptr && !output_file.write(0, static_cast<const char *>(mapping), reply.output_size))){
+            cout << "Could not write output file." << endl;
+            return -1;
+        }
+        if(mapping != nullptr){
+            munmap(mapping, reply.output_size);
+        }
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    if(verbose){
+        cout << (decode ? "Decoded " : "Encoded ") << reply.input_size << " bytes to " << reply.output_size << " bytes "
+                << n_requests << " times." << endl;
+        cout << "Latency in usecs: p50 " << HuffmanService::percentile(latencies, 50) << ", p90 " << HuffmanService::percentile(latencies, 90)
+                << ", p99 " << HuffmanService::percentile(latencies, 99) << ", max " << HuffmanService::percentile(latencies, 100) << "." << endl;
+        cout << "Service time in usecs: p50 " << HuffmanService::percentile(service_times, 50) << ", p90 " << HuffmanService::percentile(service_times, 90)
+                << ", p99 " << HuffmanService::percentile(service_times, 99) << ", max " << HuffmanService::percentile(service_times, 100) << "." << endl;
+    }
+    return 0;
+}
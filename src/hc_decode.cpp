@@ -0,0 +1,398 @@
+/**
+ * @file hc_decode.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the decoder for files encoded with huffman by any of the encoders
+ * @date 2026-10-18
+ *
+ * Uses the table driven decoder, chunks are decoded in parallel and written directly to their position in the output file.
+ * Chunks storing a checksum are all checked in parallel before the output is created, and can be checked without decoding them.
+ * Supports running multiple times for logging purposes
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <future>
+#include <atomic>
+#include <unistd.h>
+
+#include "logger.hpp"
+#include "huffman_decoder.hpp"
+#include "file_header.hpp"
+#include "output_file.hpp"
+
+using std::cout, std::clog, std::endl, std::string, std::vector;
+
+/**
+ * @brief type storing the position of a chunk in the encoded file and of its characters in the decoded file
+ * 
+ */
+typedef struct{
+    size_t header_offset;
+    size_t header_size;
+    size_t offset;
+    uint64_t size;
+    char padding;
+    uint64_t output_offset;
+    uint64_t n_chars;
+    int table;
+} chunk_info;
+
+/**
+ * @brief type to store execution times of the decoding and writing process in the threads
+ * 
+ */
+typedef struct{
+    long decode_time;
+    long write_time;
+    bool corrupted;
+} decoding_results;
+
+void print_help(){
+    cout << "The program accepts the following arguments:" << endl;
+    cout << "\t -i path: path to the file to be decoded, required." << endl;
+    cout << "\t -o path: path where the decoded file has to be saved, required unless verifying." << endl;
+    cout << "\t -t number: number of threads to use, default 4." << endl;
+    cout << "\t -V: verify the checksums of the chunks without decoding them, the file must have been encoded with -k." << endl;
+    cout << "\t -v: set verbose." << endl;
+    cout << "\t -l dir: enable logging to file, output is written to directory dir." << endl;
+}
+
+/**
+ * @brief function decoding chunks of file and writing them to their position in the output file
+ * 
+ * Chunks are assigned to threads dynamically through a shared counter.
+ * 
+ * @param decoders objects storing the decoding tables, one for each table of codes in the file
+ * @param file_buf buffer containing the whole encoded file
+ * @param chunks vector containing the position of the chunks
+ * @param next_chunk counter of the next chunk to decode
+ * @param output_file output file to write to
+ * @return decoding_results 
+ */
+decoding_results decode_chunks(const vector<HuffmanDecoder> &decoders, vector<char> &file_buf, vector<chunk_info> &chunks,
+                                std::atomic<int> &next_chunk, OutputFile &output_file){
+    Timer timer;
+    decoding_results res = {0, 0, false};
+    // buffer reused for all the chunks decoded by the thread
+    vector<unsigned char> output_buf;
+
+    for(int i = next_chunk++; i < chunks.size(); i = next_chunk++){
+        auto &chunk = chunks[i];
+        // raw chunks are written directly from the encoded file
+        const char *output = &file_buf[chunk.offset];
+        if(chunk.padding != FileHeader::RAW_CHUNK){
+            timer.start("decode");
+            output_buf.resize(chunk.n_chars);
+            uint64_t bits = decoders[chunk.table].decode(&file_buf[chunk.offset], chunk.size, output_buf.data(), chunk.n_chars);
+            res.decode_time += timer.stop();
+            if(chunk.size > 0 && bits != chunk.size * 8 - chunk.padding){
+                cout << "Chunk " << i << " is corrupted." << endl;
+                res.corrupted = true;
+                return res;
+            }
+            output = reinterpret_cast<const char *>(output_buf.data());
+        }
+
+        // each chunk has its own position in the output file, no ordering is needed
+        timer.start("write");
+        if(!output_file.write(chunk.output_offset, output, chunk.n_chars)){
+            cout << "Error while writing chunk " << i << "." << endl;
+            res.corrupted = true;
+            return res;
+        }
+        res.write_time += timer.stop();
+    }
+    return res;
+}
+
+/**
+ * @brief function checking the checksums of chunks of file without decoding them
+ *
+ * Chunks are assigned to threads dynamically through a shared counter, all of them are checked even after a failure
+ * so that every corrupted chunk is reported.
+ *
+ * @param header header of the encoded file, storing checksums
+ * @param file_buf buffer containing the whole encoded file
+ * @param chunks vector containing the position of the chunks
+ * @param next_chunk counter of the next chunk to check
+ * @param corrupted set if a chunk is corrupted
+ * @return long time spent checking the chunks
+ */
+long verify_chunks(FileHeader &header, const vector<char> &file_buf, const vector<chunk_info> &chunks,
+                    std::atomic<int> &next_chunk, std::atomic<bool> &corrupted){
+    Timer timer;
+    timer.start("verify");
+    for(int i = next_chunk++; i < chunks.size(); i = next_chunk++){
+        auto &chunk = chunks[i];
+        if(!header.verifyChunk(&file_buf[chunk.header_offset], chunk.header_size, &file_buf[chunk.offset], chunk.size)){
+            // the report of a chunk is written with a single call, so that reports of different threads are not mixed
+            cout << "Chunk " + std::to_string(i) + " is corrupted.\n";
+            corrupted = true;
+        }
+    }
+    return timer.stop();
+}
+
+int main(int argc, char* argv[]){
+
+    string filename = "";
+    string output_filename = "";
+    int n_threads = 4;
+    bool verbose = false;
+    string log_folder = "";
+    // the checksums of the chunks are checked and nothing is decoded
+    bool verify = false;
+
+    // parse command line arguments
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hi:o:t:vl:V")) != -1) {
+        switch (opt) {
+        case 'h':
+            print_help();
+            return 1;
+        case 'i':
+            filename = optarg;
+            break;
+        case 'o':
+            output_filename = optarg;
+            break;
+        case 't':
+            n_threads = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'l':
+            log_folder = optarg;
+            break;
+        case 'V':
+            verify = true;
+            break;
+        default:
+            print_help();
+            return 0;
+        }
+    }
+
+    if((filename == "") || !std::filesystem::exists(filename) || (output_filename == "" && !verify)){
+        cout << "Input and output filenames are required or input file does not exist." << endl;
+        print_help();
+        return 0;
+    }
+    if(n_threads <= 0){
+        cout << "Number of threads must be positive." << endl;
+        print_help();
+        return 0;
+    }
+
+    // build path to save logs
+    string log_file = "./" + log_folder + "/decode/" + std::to_string(n_threads) + "_" + filename;
+    log_file = log_file.substr(0, log_file.find_last_of('.'))+".csv";
+
+    Logger logger(log_file, n_threads);
+    Timer timer;
+    long elapsed_time;
+
+    timer.start("total");
+
+    // read the whole encoded file, the size is not known if the input is not a regular file
+    std::error_code ec;
+    size_t filesize = std::filesystem::file_size(filename, ec);
+    vector<char> file_buf(ec ? 0 : filesize);
+    logger.start("reading_input");
+        std::ifstream file(filename, std::ios::binary);
+        bool read_ok = !ec && file.read(file_buf.data(), filesize);
+        file.close();
+    elapsed_time = logger.stop();
+
+    if(!read_ok){
+        cout << "Could not read input file." << endl;
+        return -1;
+    }
+    if(verbose){
+        cout << "Reading input file took " << elapsed_time << " usecs." << endl;
+    }
+
+    // read the header, all the versions are supported
+    FileHeader header;
+    size_t pos = header.parse(file_buf.data(), filesize);
+    if(pos == 0){
+        cout << "Input file is not a valid encoded file." << endl;
+        return -1;
+    }
+    if(verify && !header.hasChecksums()){
+        cout << "Input file does not store checksums, it has to be encoded with -k." << endl;
+        return -1;
+    }
+    int n_chunks = header.getNChunks();
+    uint64_t n_chars = header.getNChars();
+
+    // scan the chunk headers to find the position of each chunk
+    // adaptive files store the codes in the chunks, a chunk without codes uses the ones of the previous chunk
+    // streams store the number of characters of each chunk and end with an empty chunk
+    vector<chunk_info> chunks;
+    vector<vector<int>> tables;
+    uint64_t output_offset = 0;
+    bool adaptive = header.getVersion() >= FileHeader::ADAPTIVE;
+    bool stream = header.getVersion() == FileHeader::STREAM;
+    for(int i=0; stream || i<n_chunks; i++){
+        chunk_info chunk;
+        vector<int> code_lengths;
+        uint64_t chunk_chars;
+        size_t chunk_header = header.parseChunk(&file_buf[pos], filesize - pos, i, chunk.size, chunk.padding, &code_lengths, &chunk_chars);
+        if(stream && chunk_header != 0 && chunk_chars == 0){
+            break;
+        }
+        // chunks must fit in the file and hold their characters, see parseChunk,
+        // and the first chunk which is not raw must store its codes
+        bool raw = chunk.padding == FileHeader::RAW_CHUNK;
+        chunk.n_chars = chunk_chars;
+        if(chunk_header == 0 || (adaptive && !raw && tables.empty() && code_lengths.empty())){
+            cout << "Input file is truncated or corrupted." << endl;
+            return -1;
+        }
+        if(!code_lengths.empty()){
+            tables.push_back(code_lengths);
+        }
+        chunk.table = adaptive ? tables.size() - 1 : 0;
+        chunk.header_offset = pos;
+        chunk.header_size = chunk_header;
+        pos += chunk_header;
+        chunk.offset = pos;
+        chunk.output_offset = output_offset;
+        output_offset += chunk.n_chars;
+        pos += chunk.size;
+        chunks.push_back(chunk);
+    }
+    if(stream){
+        n_chunks = chunks.size();
+        n_chars = output_offset;
+    }
+
+    // checksums are checked before the output is created, so that a corrupted file does not leave a partial output behind
+    if(verify || header.hasChecksums()){
+        // no point in having more threads than chunks
+        int n_workers = std::min(n_threads, n_chunks);
+        std::atomic<int> next_chunk = 0;
+        std::atomic<bool> corrupted = false;
+        long verify_time = 0;
+
+        logger.start("verify");
+            vector<std::future<long>> verify_tids;
+            for(int i=0; i<n_workers; i++){
+                verify_tids.push_back(std::async(std::launch::async, verify_chunks, std::ref(header), std::cref(file_buf),
+                                                    std::cref(chunks), std::ref(next_chunk), std::ref(corrupted)));
+            }
+            for(auto &t : verify_tids){
+                verify_time += t.get();
+            }
+        elapsed_time = logger.stop();
+        logger.add_stat("verify_threads", verify_time);
+
+        if(corrupted){
+            return -1;
+        }
+        if(verbose){
+            cout << "Verifying the chunks took " << elapsed_time << " usecs, " << verify_time
+                 << " usecs in overall computation time between threads." << endl;
+        }
+        if(verify){
+            cout << "All the " << n_chunks << " chunks are intact." << endl;
+            if(verbose){
+                cout<<endl<<endl;
+            }
+            logger.add_stat("total", timer.stop());
+            if(log_folder != ""){
+                std::filesystem::create_directory("./" + log_folder);
+                std::filesystem::create_directory("./" + log_folder + "/decode");
+                logger.write_logs(log_file);
+            }
+            return 0;
+        }
+    }
+
+    // the output file is created with its final size, so that chunks can be written in any order.
+    // All the chunks were found in the file and can hold their characters, so the size is at most 8 times the one
+    // of the file, allocate reserves the space on disk and must not be trusted with a larger size.
+    // The output is removed on errors, so that no partial file is left behind
+    if(n_chars / 8 > filesize){
+        cout << "Input file is truncated or corrupted." << endl;
+        return -1;
+    }
+    OutputFile output_file(output_filename);
+    if(!output_file.is_open() || !output_file.allocate(n_chars)){
+        cout << "Could not create output file." << endl;
+        std::filesystem::remove(output_filename);
+        return -1;
+    }
+
+    long decode_time = 0;
+    long write_time = 0;
+    bool corrupted = false;
+    if(n_chars > 0){
+        // create the lookup tables, legacy headers need to rebuild the huffman tree first
+        logger.start("huffman_tree_creation");
+            vector<HuffmanDecoder> decoders;
+            if(adaptive){
+                for(auto &code_lengths : tables){
+                    decoders.emplace_back(HuffmanTree::canonicalCodes(code_lengths));
+                }
+            }
+            else{
+                decoders.emplace_back(header.getCodes());
+            }
+        elapsed_time = logger.stop();
+
+        if(verbose){
+            cout << "Creating the decoding tables took " << elapsed_time << " usecs." << endl;
+        }
+
+        // no point in having more threads than chunks
+        int n_workers = std::min(n_threads, n_chunks);
+        std::atomic<int> next_chunk = 0;
+
+        logger.start("decode_and_write");
+            vector<std::future<decoding_results>> decode_tids;
+            for(int i=0; i<n_workers; i++){
+                decode_tids.push_back(move(std::async(std::launch::async, decode_chunks, std::cref(decoders),
+                                                std::ref(file_buf), std::ref(chunks), std::ref(next_chunk), std::ref(output_file))));
+            }
+            for(auto &t : decode_tids){
+                auto res = t.get();
+                decode_time += res.decode_time;
+                write_time += res.write_time;
+                corrupted |= res.corrupted;
+            }
+        elapsed_time = logger.stop();
+
+        logger.add_stat("decode", decode_time);
+        logger.add_stat("write", write_time);
+
+        if(verbose){
+            cout << "Decoding and writing the file took " << elapsed_time << " usecs." << endl;
+            cout << "Decoding the file took " << decode_time << " usecs in overall computation time between threads." << endl;
+            cout << "Writing decoded file took " << write_time << " usecs." << endl;
+        }
+    }
+    if(corrupted){
+        std::filesystem::remove(output_filename);
+        return -1;
+    }
+
+    if(verbose){
+        cout << "Decoded file is " << n_chars << " characters long" << endl;
+        cout<<endl<<endl;
+    }
+
+    logger.add_stat("total", timer.stop());
+    if(log_folder != ""){
+        std::filesystem::create_directory("./" + log_folder);
+        std::filesystem::create_directory("./" + log_folder + "/decode");
+        logger.write_logs(log_file);
+    }
+    return 0;
+}
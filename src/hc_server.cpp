@@ -0,0 +1,238 @@
+/**
+ * @file hc_server.cpp
+ * @author Davide Amadei (davide.amadei97@gmail.com)
+ * @brief file containing the server encoding and decoding files for local clients over a Unix domain socket
+ * @date 2026-10-18
+ *
+ * The server keeps its threads, buffers and tables of codes between requests, so that small payloads do not pay
+ * for starting a process and building their tables. Clients pass the descriptors of their files, see hc_client.
+ * Each thread serves one connection at a time, a connection can send any number of requests.
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "logger.hpp"
+#include "huffman_tree.hpp"
+#include "huffman_service.hpp"
+#include "thread_pool.hpp"
+
+using std::cout, std::endl, std::string, std::vector;
+
+/**
+ * @brief event signalled to stop the server, threads wait for it along with their sockets
+ *
+ */
+static int stop_fd = -1;
+
+/**
+ * @brief function stopping the server, safe to call from a signal handler
+ *
+ */
+void request_stop(int){
+    uint64_t one = 1;
+    ssize_t ret = write(stop_fd, &one, sizeof(one));
+    (void)ret;
+}
+
+void print_help(){
+    cout << "The program accepts the following arguments:" << endl;
+    cout << "\t -s path: path of the socket to listen on, default " << HuffmanService::DEFAULT_SOCKET << "." << endl;
+    cout << "\t -t number: number of threads to use, each one serves a connection at a time, default 4." << endl;
+    cout << "\t -A policy: placement of the threads, compact, scatter, none or a list of CPUs such as 0,2,4-7, default none." << endl;
+    cout << "\t -m bits: maximum length of the codes, between 1 and 32, default no limit." << endl;
+    cout << "\t -v: set verbose, statistics of the requests are printed when the server stops." << endl;
+    cout << "The server stops on SIGINT, SIGTERM or when a client asks it to." << endl;
+}
+
+int main(int argc, char* argv[]){
+
+    string socket_path = HuffmanService::DEFAULT_SOCKET;
+    int n_threads = 4;
+    string affinity = "";
+    int max_length = 0;
+    bool verbose = false;
+
+    // parse command line arguments
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hs:t:A:m:v")) != -1) {
+        switch (opt) {
+        case 'h':
+            print_help();
+            return 1;
+        case 's':
+            socket_path = optarg;
+            break;
+        case 't':
+            n_threads = atoi(optarg);
+            break;
+        case 'A':
+            affinity = optarg;
+            break;
+        case 'm':
+            max_length = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            print_help();
+            return 0;
+        }
+    }
+
+    if(n_threads <= 0){
+        cout << "Number of threads must be positive." << endl;
+        print_help();
+        return 0;
+    }
+    if(max_length < 0 || max_length > HuffmanTree::MAX_CODE_LENGTH){
+        cout << "Maximum length of the codes must be between 1 and " << HuffmanTree::MAX_CODE_LENGTH << "." << endl;
+        print_help();
+        return 0;
+    }
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if(socket_path == "" || socket_path.size() >= sizeof(addr.sun_path)){
+        cout << "Path of the socket must be shorter than " << sizeof(addr.sun_path) << " characters." << endl;
+        print_help();
+        return 0;
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    // a socket left by a server which did not stop cleanly is replaced, any other file is not
+    struct stat st;
+    if(lstat(socket_path.c_str(), &st) == 0){
+        if(!S_ISSOCK(st.st_mode)){
+            cout << "Path of the socket exists and is not a socket." << endl;
+            return -1;
+        }
+        unlink(socket_path.c_str());
+    }
+
+    // the listening socket does not block, so that threads woken for a connection taken by another one go back to waiting
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    int listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if(stop_fd < 0 || listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+            || listen(listen_fd, SOMAXCONN) != 0){
+        cout << "Could not listen on socket " << socket_path << "." << endl;
+        return -1;
+    }
+    signal(SIGINT, request_stop);
+    signal(SIGTERM, request_stop);
+
+    HuffmanService service(n_threads, max_length);
+    // times of the requests and bytes read by each thread
+    vector<vector<long>> service_times(n_threads);
+    std::atomic<long> n_failed = 0;
+    std::atomic<uint64_t> input_bytes = 0;
+    std::atomic<uint64_t> output_bytes = 0;
+
+    auto serve_connection = [&](int conn, int tid){
+        Timer timer;
+        while(true){
+            pollfd fds[2] = {{conn, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+            if(poll(fds, 2, -1) < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                return;
+            }
+            if(fds[1].revents != 0){
+                return;
+            }
+
+            service_request request;
+            int request_fds[2];
+            int n_fds;
+            ssize_t size = HuffmanService::receive_message(conn, &request, sizeof(request), request_fds, 2, n_fds);
+            if(size <= 0){
+                for(int i=0; i<n_fds; i++){
+                    close(request_fds[i]);
+                }
+                return;
+            }
+
+            timer.start("request");
+            service_reply reply = {request.op, HuffmanService::OK, request.id, 0, 0, 0};
+            bool data_request = request.op == HuffmanService::COMPRESS || request.op == HuffmanService::DECOMPRESS;
+            if(size != sizeof(request) || (data_request && n_fds != 2) || (!data_request && request.op != HuffmanService::SHUTDOWN)){
+                reply.status = HuffmanService::BAD_REQUEST;
+            }
+            else if(request.op == HuffmanService::COMPRESS){
+                reply.status = service.compress(request_fds[0], request_fds[1], tid, reply.input_size, reply.output_size);
+            }
+            else if(request.op == HuffmanService::DECOMPRESS){
+                reply.status = service.decompress(request_fds[0], request_fds[1], tid, reply.input_size, reply.output_size);
+            }
+            else{
+                request_stop(0);
+            }
+            for(int i=0; i<n_fds; i++){
+                close(request_fds[i]);
+            }
+            reply.service_time = timer.stop();
+
+            if(data_request && reply.status == HuffmanService::OK){
+                service_times[tid].push_back(reply.service_time);
+                input_bytes += reply.input_size;
+                output_bytes += reply.output_size;
+            }
+            else if(data_request){
+                n_failed++;
+            }
+            if(!HuffmanService::send_message(conn, &reply, sizeof(reply))){
+                return;
+            }
+        }
+    };
+
+    auto serve = [&](int tid){
+        while(true){
+            pollfd fds[2] = {{listen_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+            if(poll(fds, 2, -1) < 0 && errno != EINTR){
+                return;
+            }
+            if(fds[1].revents != 0){
+                return;
+            }
+            int conn = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if(conn < 0){
+                continue;
+            }
+            serve_connection(conn, tid);
+            close(conn);
+        }
+    };
+
+    if(verbose){
+        cout << "Listening on " << socket_path << " with " << n_threads << " threads." << endl;
+    }
+    ThreadPool::shared(n_threads, affinity).run(serve);
+    close(listen_fd);
+    unlink(socket_path.c_str());
+
+    if(verbose){
+        vector<long> times;
+        for(auto &t : service_times){
+            times.insert(times.end(), t.begin(), t.end());
+        }
+        cout << "Served " << times.size() << " requests, " << n_failed << " failed." << endl;
+        cout << "Read " << input_bytes << " bytes and wrote " << output_bytes << " bytes." << endl;
+        cout << "Service time in usecs: p50 " << HuffmanService::percentile(times, 50) << ", p90 " << HuffmanService::percentile(times, 90)
+                << ", p99 " << HuffmanService::percentile(times, 99) << ", max " << HuffmanService::percentile(times, 100) << "." << endl;
+        cout << "Tables found in the cache " << service.getTableHits() << " times, built " << service.getTableMisses() << " times." << endl;
+    }
+    return 0;
+}
@@ -12,16 +12,28 @@
 #include <fstream>
 #include <filesystem>
 #include <future>
-#include <mutex>
-#include <condition_variable>
+#include <algorithm>
+#include <map>
 #include "logger.hpp"
 #include "huffman_tree.hpp"
+#include "bit_writer.hpp"
+#include "file_header.hpp"
+#include "stream_encoder.hpp"
+#include "adaptive_encoder.hpp"
+#include "mapped_file.hpp"
+#include "input_file.hpp"
+#include "output_file.hpp"
+#include "async_writer.hpp"
+#include "mapped_output_file.hpp"
+#include "pipe_encoder.hpp"
+#include "batch_encoder.hpp"
+#include "histogram.hpp"
+#include "block_scheduler.hpp"
+#include "thread_pool.hpp"
+#include "encoder_options.hpp"
 
 using std::cout, std::clog, std::endl, std::string, std::vector, std::shared_ptr;
 
-// tracks the next encoded chunk to write to file
-int write_id = 0;
-
 /**
  * @brief type to store execution times of the encoding and writing process in the threads
  * 
@@ -29,277 +41,588 @@ int write_id = 0;
 typedef struct{
     long encode_time;
     long write_time;
+    bool write_ok;
+    vector<std::pair<uint64_t, char>> shared_bytes;
 } encoding_results;
 
-void print_help(){
-    cout << "The program accepts the following arguments:" << endl;
-    cout << "\t -i path: path to the file to be encoded, required." << endl;
-    cout << "\t -o path: path where the encoded file has to be saved, required." << endl;
-    cout << "\t -t number: number of threads to use, default 4." << endl;
-    cout << "\t -v: set verbose." << endl;
-    cout << "\t -l dir: enable logging to file, output is written to directory dir." << endl;
-    cout << "\t -d: debug mode, only works if logging is enabled." << endl;
-}
+/**
+ * @brief type to store execution times of the reading and counting process in the threads
+ * 
+ */
+typedef struct{
+    long read_time;
+    long freq_time;
+    bool read_ok;
+} counting_results;
+
 
 
 /**
  * @brief function to encode and write a single chunk of file
  * 
- * @param code_table table of encodings
- * @param file_chunk chunk of file to encode
- * @param id id of the thread, used for writing
- * @param output_file output filestream to write to
- * @param m mutex to use
- * @param cv condition variable to use
+ * The position of the chunk in the output file is known in advance, so chunks are written
+ * as soon as they are encoded without waiting for the previous ones.
+ * 
+ * @param writer object storing the table of encodings
+ * @param file_chunk chunk of file to encode, a view into the input file
+ * @param chunk_counts character counts of the chunk, used to size the buffer
+ * @param header header of the encoded file, used to write the header of the chunk
+ * @param offset position of the chunk in the output file
+ * @param output_file output file to write to
+ * @param async_writer writer to hand the encoded chunk to, nullptr to write it with output_file
+ * @param mapped_output mapping of the output file to encode the chunk into, nullptr to write it with output_file
  * @return encoding_results 
  */
-encoding_results encode_chunk(vector<std::pair<int,int>> &code_table, vector<unsigned char> &file_chunk, int id, std::ofstream &output_file,
-                                std::mutex &m, std::condition_variable &cv){
+encoding_results encode_chunk(const BitWriter &writer, file_span file_chunk, vector<uint64_t> &chunk_counts, FileHeader &header,
+                                uint64_t offset, OutputFile &output_file, AsyncWriter *async_writer, char *mapped_output){
     Timer timer;
-    timer.start("encode");
+    long write_time = 0;
 
-    // not reserving space here slows down code considerably because of the reallocations needed
+    // the chunk is encoded directly in a buffer of the asynchronous writer, taking it may wait for previous writes
     vector<char> buffer_vec;
-    buffer_vec.reserve(file_chunk.size()*2/3);
-
-    // current size of the buffer
-    int buf_len = 0;
-    char buffer = 0;
-    // remaining bits to save to buffer for currently considered character
-    // is initialized with the length of the encoding for each character
-    int remaining;
-    // code of the character, stored as an int
-    int code;
-    // size of a single buffer
-    const int max_size = sizeof(char) * 8;
+    char *buffer;
+    if(async_writer != nullptr){
+        timer.start("write");
+        buffer = async_writer->acquire(offset);
+        write_time += timer.stop();
+    }
+    // or in its slice of the mapped output file, so that nothing is copied
+    else if(mapped_output != nullptr){
+        buffer = mapped_output + offset;
+    }
+
+    timer.start("encode");
+
+    // the header of the chunk is written before the encoding, so that the chunk is written with a single call
+    size_t chunk_header_size = header.serializeChunk(0, 0).size();
+
+    // the exact size of the encoding is known from the character counts of the chunk
+    // so the buffer is allocated only once, and chunks which would not shrink are stored raw
+    uint64_t n_bits = writer.encoded_bits(chunk_counts);
+    bool raw = header.storeRaw(n_bits, file_chunk.size);
+    if(async_writer == nullptr && mapped_output == nullptr){
+        buffer_vec.resize(chunk_header_size + (raw ? file_chunk.size : BitWriter::buffer_size(n_bits)));
+        buffer = buffer_vec.data();
+    }
 
     // actual encoding of the file
     // encoding is stored into a vector of chars
-    for(auto &c : file_chunk){
-        auto code_pair = code_table[int(c)];
-        code = code_pair.second;
-        remaining = code_pair.first;
-
-        // loop saving the encoding of the character to the buffer
-        while(remaining != 0){
-            // buffer has reached maximum size
-            if(buf_len==max_size){
-                // flush buffer to vector
-                buffer_vec.push_back(buffer);
-                // reset buffer
-                buffer = 0;
-                buf_len = 0;
-            }
-            // buffer has enough space to store the rest of the encoding
-            // of the current character
-            if(buf_len+remaining <= max_size){
-                // shift buffer and add code to the end
-                buffer = (buffer << remaining) | code;
-                //update buffer size
-                buf_len += remaining;
-                remaining = 0;
-            }
-            // buffer does not have enough space to store the rest of the encoding
-            // of the current character 
-            else{
-                int shift = max_size-buf_len;
-                // shift buffer to left and shift encoding to right
-                buffer = (buffer << shift) | (code >> (remaining - shift));
-                remaining -= shift;
-                buf_len = max_size;
-            }
-        }
+    // the next chunk follows in the mapping, so only the bytes of the encoding are written
+    if(raw){
+        std::copy(file_chunk.data, file_chunk.data + file_chunk.size, buffer + chunk_header_size);
     }
-    // flush buffer if necessary and add padding bits to the end
-    if(buf_len!=0){
-        buffer_vec.push_back(buffer << (max_size-buf_len));
+    else{
+        n_bits = writer.encode(file_chunk.data, file_chunk.size, buffer + chunk_header_size, 0, mapped_output != nullptr);
     }
 
+    uint64_t chunk_size = raw ? file_chunk.size : BitWriter::byte_size(n_bits);
+    // write size of chunk and number of padding bits, and the checksum of the chunk while it is in cache
+    auto chunk_header = header.serializeChunk(chunk_size, raw ? FileHeader::RAW_CHUNK : BitWriter::padding(n_bits), nullptr, 0,
+                                                buffer + chunk_header_size);
+    std::copy(chunk_header.begin(), chunk_header.end(), buffer);
+
     long time = timer.stop();
-    encoding_results res;
-    res.encode_time = time;
-    char padding = max_size-buf_len;
-    int chunk_size = buffer_vec.size();
+    encoding_results res = {time, write_time, true};
 
     // write to file the encoded chunk
-    if(output_file.is_open()){
-        // wait until the chunk of the thread can be written
-        std::unique_lock lk(m);
-        while(id != write_id){
-            cv.wait(lk);
+    if(async_writer != nullptr){
+        timer.start("write");
+        async_writer->submit(buffer, chunk_header_size + chunk_size, offset);
+        res.write_time += timer.stop();
+    }
+    else if(mapped_output == nullptr && output_file.is_open()){
+        timer.start("write");
+        res.write_ok = output_file.write(offset, buffer, chunk_header_size + chunk_size);
+        res.write_time = timer.stop();
+    }
+    return res;
+}
+
+/**
+ * @brief function to encode and write a part of a single contiguous bitstream
+ * 
+ * The part starts at a bit position known in advance from the character counts of the previous parts.
+ * Bytes containing only bits of this part are written directly, while its first and last bytes may contain
+ * bits of the neighbouring parts and are returned to be merged once all the parts are encoded.
+ * 
+ * @param writer object storing the table of encodings
+ * @param file_chunk chunk of file to encode, a view into the input file
+ * @param start_bit position of the first bit of the part in the bitstream
+ * @param end_bit position of the bit following the last bit of the part in the bitstream
+ * @param offset position of the bitstream in the output file
+ * @param output_file output file to write to
+ * @param async_writer writer to hand the encoded part to, nullptr to write it with output_file
+ * @return encoding_results 
+ */
+encoding_results encode_bits_at(const BitWriter &writer, file_span file_chunk, uint64_t start_bit, uint64_t end_bit,
+                                uint64_t offset, OutputFile &output_file, AsyncWriter *async_writer){
+    Timer timer;
+    long write_time = 0;
+
+    // first byte touched by the part and range of bytes not shared with other parts
+    uint64_t first = start_bit / 8;
+    uint64_t last = (end_bit + 7) / 8;
+    uint64_t own_first = (start_bit + 7) / 8;
+    uint64_t own_last = std::max(end_bit / 8, own_first);
+
+    // the part is encoded directly in a buffer of the asynchronous writer, taking it may wait for previous writes
+    vector<char> buffer_vec;
+    char *buffer;
+    if(async_writer != nullptr){
+        timer.start("write");
+        buffer = async_writer->acquire(offset + first);
+        write_time += timer.stop();
+    }
+
+    timer.start("encode");
+
+    // the bits of the first byte belonging to the previous part are left to 0
+    int skip = start_bit % 8;
+    if(async_writer == nullptr){
+        buffer_vec.resize(BitWriter::buffer_size(end_bit - start_bit + skip));
+        buffer = buffer_vec.data();
+    }
+    writer.encode(file_chunk.data, file_chunk.size, buffer, skip);
+
+    long time = timer.stop();
+    encoding_results res = {time, write_time, true};
+
+    for(uint64_t b=first; b<last; b++){
+        if(b < own_first || b >= own_last){
+            res.shared_bytes.push_back({b, buffer[b - first]});
         }
+    }
+
+    if(async_writer != nullptr){
+        // the buffer goes back to the writer also when there is nothing to write
         timer.start("write");
-        // write size of chunk
-        output_file.write(reinterpret_cast<const char *>(&chunk_size), sizeof(chunk_size));
-        // write number of padding bits
-        output_file.write(&padding, 1);
-        // write the encoded binary
-        output_file.write(buffer_vec.data(), buffer_vec.size());
-        time = timer.stop();
-
-        res.write_time = time;
-        write_id++;
-        cv.notify_all();
-        return res;
+        async_writer->submit(buffer + (own_first - first), own_last - own_first, offset + own_first);
+        res.write_time += timer.stop();
     }
-    else{
-        return res;
+    else if(output_file.is_open() && own_first < own_last){
+        timer.start("write");
+        res.write_ok = output_file.write(offset + own_first, buffer + (own_first - first), own_last - own_first);
+        res.write_time = timer.stop();
     }
+    return res;
 }
 
-int main(int argc, char* argv[]){
+/**
+ * @brief function encoding a stream in blocks with their own codes, written in order as soon as they are encoded
+ * 
+ * @param options options of the encoder, already validated
+ * @param logger logger the times of the phases are added to
+ * @return int 0 if the input was encoded, -1 otherwise
+ */
+int encode_stream(const EncoderOptions &options, Logger &logger){
+    // use array to store character counts
+    // can be directly indexed using ASCII characters
+    vector<uint64_t> count_vector(256, 0);
+    long elapsed_time;
+
+    // messages go to the standard error when the encoding is written to the standard output
+    std::ostream &info = options.output_filename == "-" ? clog : cout;
+    uint64_t stream_block_size = options.block_size == 0 ? FileHeader::DEFAULT_CHUNK_CHARS : options.block_size;
+    PipeEncoder encoder(options.filename, options.output_filename, stream_block_size, options.n_threads,
+                        options.latency == -1 ? PipeEncoder::DEFAULT_LATENCY : options.latency, options.max_code_length);
+    FileHeader header(stream_block_size);
+    header.setChecksums(options.checksums);
+
+    // the preloaded codes are built from all the characters of the file, counted in blocks
+    if(options.preload_filename != ""){
+        logger.start("preload");
+            StreamEncoder preload_stream(options.preload_filename, FileHeader::DEFAULT_CHUNK_CHARS, options.n_threads);
+            bool ok = preload_stream.count(count_vector);
+            HuffmanTree preload_ht(count_vector, options.max_code_length);
+            encoder.preload(preload_ht.getCodeLengths());
+        elapsed_time = logger.stop();
+        if(!ok){
+            info << "Could not read the file to build the preloaded codes from." << endl;
+            return -1;
+        }
+        if(options.verbose){
+            info << "Building the preloaded codes took " << elapsed_time << " usecs." << endl;
+        }
+    }
+
+    // single pass over the stream, blocks are written in order as soon as they are encoded
+    logger.start("encode_and_write");
+        bool ok = encoder.encode(header);
+    elapsed_time = logger.stop();
+    logger.add_stat("reading_input", encoder.getReadTime());
+    logger.add_stat("freq_time", encoder.getFreqTime());
+    logger.add_stat("encode", encoder.getEncodeTime());
+    logger.add_stat("write", encoder.getWriteTime());
+    logger.add_stat("max_delay", encoder.getMaxDelay());
+
+    if(!ok){
+        info << "Could not encode input stream." << endl;
+        return -1;
+    }
+    if(options.verbose){
+        info << "Reading, counting, encoding and writing the stream took " << elapsed_time << " usecs." << endl;
+        info << "Reading input took " << encoder.getReadTime() << " usecs, waiting for it included." << endl;
+        info << "Counting characters and building the codes took " << encoder.getFreqTime() << " usecs in overall computation time between threads." << endl;
+        info << "Encoding the stream took " << encoder.getEncodeTime() << " usecs." << endl;
+        info << "Writing encoded stream took " << encoder.getWriteTime() << " usecs." << endl;
+        info << encoder.getNTables() << " tables of codes were written for " << encoder.getNBlocks() << " blocks of "
+             << encoder.getNChars() << " characters in total." << endl;
+        info << "The longest time from the arrival of a block to the end of its write was " << encoder.getMaxDelay() << " usecs." << endl;
+        encoder.getLimitReport().print(info, options.max_code_length);
+    }
 
-    std::mutex m;
-    std::condition_variable cv;
-
-    string filename = "";
-    string output_filename = "";
-    int n_threads = 4;
-    bool verbose = false;
-    string log_folder = "";
-
-    // used to log parallel frequency count without including time spent reading from file
-    bool debug = false;
-
-    // parse command line arguments
-    int opt;
-
-    while ((opt = getopt(argc, argv, "hi:o:t:vl:d")) != -1) {
-        switch (opt) {
-        case 'h':
-            print_help();
-            return 1;
-        case 'i':
-            filename = optarg;
-            break;
-        case 'o':
-            output_filename = optarg;
-            break;
-        case 't':
-            n_threads = atoi(optarg);
-            break;
-        case 'v':
-            verbose = true;
-            break;
-        case 'l':
-            log_folder = optarg;
-            break;
-        case 'd':
-            debug = true;
-            break;
-        default:
-            print_help();
-            return 0;
+    return 0;
+}
+
+/**
+ * @brief function encoding a batch of files, each one to its own file in the output directory
+ * 
+ * @param options options of the encoder, already validated
+ * @param logger logger the times of the phases are added to
+ * @return int 0 if the input was encoded, -1 otherwise
+ */
+int encode_batch(const EncoderOptions &options, Logger &logger){
+    long elapsed_time;
+
+    std::error_code ec;
+    std::filesystem::create_directories(options.output_filename, ec);
+    if(ec || !std::filesystem::is_directory(options.output_filename)){
+        cout << "Could not create output directory." << endl;
+        return -1;
+    }
+
+    // all the files share the threads of the pool, small files are packed together and large ones split in chunks
+    BatchEncoder encoder(options.batch_filenames, options.batch_outputs, options.n_threads, options.max_code_length, options.checksums);
+    logger.start("encode_and_write");
+        bool ok = encoder.encode();
+    elapsed_time = logger.stop();
+    logger.add_stat("reading_input", encoder.getReadTime());
+    logger.add_stat("freq_time", encoder.getFreqTime());
+    logger.add_stat("encode", encoder.getEncodeTime());
+    logger.add_stat("write", encoder.getWriteTime());
+
+    if(!ok){
+        for(int i=0; i<encoder.getNFiles(); i++){
+            if(!encoder.isEncoded(i)){
+                cout << "Could not encode " << options.batch_filenames[i] << "." << endl;
+            }
         }
+        return -1;
+    }
+    if(options.verbose){
+        cout << "Reading, counting, encoding and writing " << encoder.getNFiles() << " files took " << elapsed_time << " usecs." << endl;
+        cout << "Reading input took " << encoder.getReadTime() << " usecs in overall time between threads." << endl;
+        cout << "Counting characters and building the codes took " << encoder.getFreqTime() << " usecs in overall computation time between threads." << endl;
+        cout << "Encoding the files took " << encoder.getEncodeTime() << " usecs." << endl;
+        cout << "Writing encoded files took " << encoder.getWriteTime() << " usecs." << endl;
+        cout << encoder.getNTasks() << " tasks were run in " << encoder.getNRounds() << " rounds for "
+             << encoder.getNChars() << " characters in total." << endl;
+        encoder.getLimitReport().print(cout, options.max_code_length);
     }
 
-    // fail if debug was enabled without logging enabled as well
-    if(debug && log_folder == ""){
-        cout << "Debug mode cannot be enabled without logging enabled." << endl;
-        print_help();
-        return 0;
+    return 0;
+}
+
+/**
+ * @brief function encoding a file in blocks, each one with the codes built from its own characters
+ * 
+ * @param options options of the encoder, already validated
+ * @param logger logger the times of the phases are added to
+ * @return int 0 if the input was encoded, -1 otherwise
+ */
+int encode_adaptive(const EncoderOptions &options, Logger &logger){
+    long elapsed_time;
+
+    AdaptiveEncoder encoder(options.filename, options.block_size, options.n_threads, options.max_code_length);
+    FileHeader header(encoder.getNBlocks(), options.filesize, options.block_size);
+    header.setChecksums(options.checksums);
+
+    // single pass over the blocks, each one is counted, encoded and written by the same thread
+    logger.start("encode_and_write");
+        auto header_buf = header.serialize();
+        OutputFile output_file(options.output_filename);
+        bool ok = output_file.is_open() && output_file.write(0, header_buf.data(), header_buf.size())
+                    && encoder.encode(header, output_file, header_buf.size());
+    elapsed_time = logger.stop();
+    logger.add_stat("reading_input", encoder.getReadTime());
+    logger.add_stat("freq_time", encoder.getFreqTime());
+    logger.add_stat("encode", encoder.getEncodeTime());
+    logger.add_stat("write", encoder.getWriteTime());
+
+    if(!ok){
+        cout << "Could not encode input file." << endl;
+        return -1;
+    }
+    if(options.verbose){
+        cout << "Reading, counting, encoding and writing the file took " << elapsed_time << " usecs." << endl;
+        cout << "Reading input took " << encoder.getReadTime() << " usecs in overall time between threads." << endl;
+        cout << "Counting characters and building the codes took " << encoder.getFreqTime() << " usecs in overall computation time between threads." << endl;
+        cout << "Encoding the file took " << encoder.getEncodeTime() << " usecs." << endl;
+        cout << "Writing encoded file took " << encoder.getWriteTime() << " usecs." << endl;
+        cout << encoder.getNTables() << " tables of codes were written for " << encoder.getNBlocks() << " blocks." << endl;
+        encoder.getLimitReport().print(cout, options.max_code_length);
     }
-    // fail if input file does not exist or is missing
-    if((filename == "" || !std::filesystem::exists(filename))){
-        cout << "Input filename is missing or file does not exist." << endl;
-        print_help();
-        return 0;
+
+    return 0;
+}
+
+/**
+ * @brief function encoding a file in blocks with the codes of the whole file
+ * 
+ * The file is read once to count its characters, or only its sample, and again while encoding.
+ * 
+ * @param options options of the encoder, already validated
+ * @param logger logger the times of the phases are added to
+ * @return int 0 if the input was encoded, -1 otherwise
+ */
+int encode_blocks(const EncoderOptions &options, Logger &logger){
+    // use array to store character counts
+    // can be directly indexed using ASCII characters
+    vector<uint64_t> count_vector(256, 0);
+    long elapsed_time;
+
+    StreamEncoder stream(options.filename, options.block_size, options.n_threads);
+
+    // counting pass over the blocks, the file is read again while encoding
+    // when sampling only the sample is read and the file is read once
+    logger.start("read_and_count");
+        bool ok = options.sample_size != 0 ? stream.sample(options.sample_size, count_vector) : stream.count(count_vector);
+    elapsed_time = logger.stop();
+    logger.add_stat("reading_input", stream.getReadTime());
+    logger.add_stat("freq_time", stream.getComputeTime());
+
+    if(!ok){
+        cout << "Could not read input file." << endl;
+        return -1;
     }
-    // fail if no output file was given without debug enabled
-    if((output_filename == "" && !debug)){
-        cout << "Output filename is required." << endl;
-        print_help();
-        return 0;
+    if(options.verbose){
+        cout << "Reading input and counting character frequency took " << elapsed_time << " real usecs." << endl;
+        cout << "Reading input took " << stream.getReadTime() << " usecs in overall time between threads." << endl;
+        cout << "Counting characters took " << stream.getComputeTime() << " usecs in overall computation time between threads." << endl;
     }
 
-    // build path to save logs
-    // assumes input file ends in 3 letter long file format e.g. .txt
-    string log_file = "./" + log_folder + "/par/" + std::to_string(n_threads) + "_" + filename;
-    log_file = log_file.substr(0, log_file.find_last_of('.'))+".csv";
+    logger.start("huffman_tree_creation");
+        HuffmanTree ht(count_vector, options.max_code_length);
+    elapsed_time = logger.stop();
 
-    Logger logger(log_file, n_threads);
-    Timer timer;
-    long elapsed_time; 
-    Timer tot_timer;
-    
-    // loop n_times
-    tot_timer.start("total");
-    write_id=0;
-    std::ifstream file(filename);
+    if(options.verbose){
+        cout << "Creating the Huffman tree and extracting the code table took " << elapsed_time << " usecs." << endl;
+        // compare with the unrestricted codes to report the loss in compression
+        LengthLimitReport limit_report;
+        limit_report.add(ht, count_vector);
+        limit_report.print(cout, options.max_code_length);
+    }
+
+    // each block is a chunk of the encoded file
+    FileHeader header(options.header_version, stream.getNBlocks(), count_vector, ht, options.block_size);
+    header.setChecksums(options.checksums);
+    // estimated frequencies do not add up to the length of the file
+    header.setNChars(options.filesize);
+    BitWriter writer(header.getCodes());
+    std::ofstream output_file(options.output_filename, std::ios::binary);
 
-    int filesize = std::filesystem::file_size(filename);
+    // encoding pass, blocks are read, encoded and written in order through a bounded number of buffers
+    logger.start("encode_and_write");
+        auto header_buf = header.serialize();
+        output_file.write(header_buf.data(), header_buf.size());
+        // when sampling, the characters are also counted to report the loss in compression
+        vector<uint64_t> exact_counts;
+        ok = stream.encode(writer, header, output_file, options.verbose && options.sample_size != 0 ? &exact_counts : nullptr);
+        output_file.close();
+    elapsed_time = logger.stop();
+    logger.add_stat("reading_input", stream.getReadTime());
+    logger.add_stat("encode", stream.getComputeTime());
+    logger.add_stat("write", stream.getWriteTime());
 
-    // vector of buffers to store the file in chunks
-    vector<vector<unsigned char>> file_chunks(n_threads);
-    int chunk_size = filesize / n_threads;
+    if(!ok){
+        cout << "Could not encode input file." << endl;
+        return -1;
+    }
+    if(options.verbose && options.sample_size != 0){
+        // compare with the codes built from the exact frequencies to report the loss in compression
+        HuffmanTree exact_ht(exact_counts, options.max_code_length);
+        uint64_t sampled_bits = ht.encodedBits(exact_counts);
+        uint64_t exact_bits = exact_ht.encodedBits(exact_counts);
+        double loss = exact_bits == 0 ? 0 : 100.0 * (sampled_bits - exact_bits) / exact_bits;
+        cout << "Building the codes from a sample makes the encoding " << (sampled_bits - exact_bits) / 8
+             << " bytes larger (" << loss << "% of the encoding with exact counts)." << endl;
+    }
+    if(options.verbose){
+        cout << "Reading, encoding and writing the file took " << elapsed_time << " usecs." << endl;
+        cout << "Encoding the file took " << stream.getComputeTime() << " usecs." << endl;
+        cout << "Writing encoded file took " << stream.getWriteTime() << " usecs." << endl;
+    }
 
-    // vector of vectors storing partial character counts
-    vector<vector<int>> partial_counts(n_threads, vector<int>(256, 0));
+    return 0;
+}
 
-    // vector storing thread ids
-    vector<std::future<long>> count_tids;
+/**
+ * @brief function encoding a file in memory, split in chunks counted and encoded in parallel
+ * 
+ * @param options options of the encoder, already validated
+ * @param logger logger the times of the phases are added to
+ * @param pool threads running the parallel phases
+ * @return int 0 if the input was encoded, -1 otherwise
+ */
+int encode_in_memory(const EncoderOptions &options, Logger &logger, ThreadPool &pool){
+    // use array to store character counts
+    // can be directly indexed using ASCII characters
+    vector<uint64_t> count_vector(256, 0);
+    Timer timer;
+    long elapsed_time;
+
+    // by default the file is mapped in memory and each thread works on views of its chunks, so nothing is copied
+    // with positional reads each thread reads its own chunks into buffers which are not initialized
+    timer.start("reading_input");
+    std::unique_ptr<MappedFile> mapped_file;
+    std::unique_ptr<InputFile> input_file;
+    bool open;
+    if(options.positional){
+        input_file = std::make_unique<InputFile>(options.filename);
+        open = input_file->is_open();
+    }
+    else{
+        mapped_file = std::make_unique<MappedFile>(options.filename);
+        open = mapped_file->is_open();
+    }
+    long read_time = timer.stop();
+    if(!open){
+        cout << "Could not read input file." << endl;
+        return -1;
+    }
 
-    // function acting as body of thread to count characters of a chunk of file
-    auto count_chars = [&partial_counts, &file_chunks](int tid){
+    // the file is split in chunks of a fixed size, which do not depend on the number of threads
+    // the legacy header only describes chunks of even length, so their size depends on the file
+    int n_chunks = std::max(uint64_t(1), (options.filesize + FileHeader::DEFAULT_CHUNK_CHARS - 1) / FileHeader::DEFAULT_CHUNK_CHARS);
+    uint64_t chunk_size = options.header_version >= FileHeader::CANONICAL_64 ? FileHeader::DEFAULT_CHUNK_CHARS : options.filesize / n_chunks;
+    // vector of views of the chunks of the file
+    vector<file_span> file_chunks(n_chunks);
+    // buffers storing the chunks, only used with positional reads
+    vector<std::unique_ptr<unsigned char[]>> chunk_buffers(n_chunks);
+
+    // character counts of each chunk, used to compute the size of its encoding
+    // counts are allocated by the thread counting the chunk, so that they are on the memory node of its CPU
+    vector<vector<uint64_t>> chunk_counts(n_chunks);
+    // vector of vectors storing partial character counts of each thread, also allocated by the threads
+    vector<vector<uint64_t>> partial_counts(options.n_threads);
+
+    // results of the threads in the last counting phase
+    vector<counting_results> count_res(options.n_threads);
+
+    // function acting as body of thread to read and count characters of the chunks assigned by the scheduler
+    auto count_chars = [&partial_counts, &chunk_counts, &file_chunks, &chunk_buffers, &input_file, &count_res, chunk_size]
+                        (BlockScheduler &scheduler, int tid, bool load, bool count){
         Timer timer;
-        timer.start("freq_time");
-        for(int i=0; i<file_chunks[tid].size(); i++){
-            partial_counts[tid][int(file_chunks[tid][i])]++;
+        auto &res = count_res[tid];
+        res = {0, 0, true};
+        int i;
+        if(count){
+            partial_counts[tid].assign(256, 0);
+        }
+        while(res.read_ok && scheduler.next(tid, i)){
+            auto &chunk = file_chunks[i];
+            if(load){
+                timer.start("reading_input");
+                chunk_buffers[i].reset(new unsigned char[chunk.size]);
+                res.read_ok = input_file->read(i * chunk_size, chunk.size, chunk_buffers[i].get());
+                chunk.data = chunk_buffers[i].get();
+                res.read_time += timer.stop();
+            }
+            if(count && res.read_ok){
+                timer.start("freq_time");
+                chunk_counts[i].assign(256, 0);
+                count_bytes(chunk.data, chunk.size, chunk_counts[i]);
+                for(int c=0; c<256; c++){
+                    partial_counts[tid][c] += chunk_counts[i][c];
+                }
+                res.freq_time += timer.stop();
+            }
         }
-        long elapsed = timer.stop();
-        return elapsed;
     };
 
-    // time to read file, including the resizing of the buffer
-    long read_time = 0;
     long freq_thread_overhead = 0;
-    // read file
+    bool read_ok = true;
+    // split the file in chunks, pages not yet in memory are read in the background while counting
     logger.start("read_and_count");
-        for(int i=0; i<n_threads; i++){
-            timer.start("reading_input");
-            long read_size = chunk_size;
-            if(i==n_threads-1){
-                read_size += filesize % n_threads;
+        timer.start("reading_input");
+        for(int i=0; i<n_chunks; i++){
+            uint64_t read_size = i == n_chunks - 1 ? options.filesize - i * chunk_size : chunk_size;
+            if(options.positional){
+                file_chunks[i] = {nullptr, read_size};
             }
-            file_chunks[i].resize(read_size);
-            file.read(reinterpret_cast<char *>(&(file_chunks[i])[0]), read_size);
-            read_time += timer.stop();
-
-            if(!debug){
-                timer.start("freq_thread_overhead");
-                count_tids.push_back(move(std::async(std::launch::async, count_chars, i)));
-                freq_thread_overhead += timer.stop();
+            else{
+                file_chunks[i] = mapped_file->span(i * chunk_size, read_size);
             }
         }
-        file.close();
+        if(!options.positional){
+            mapped_file->prefetch(0, options.filesize);
+        }
+        read_time += timer.stop();
+
+        BlockScheduler count_scheduler(n_chunks, options.n_threads);
+        if(!options.debug){
+            pool.run([&](int tid){count_chars(count_scheduler, tid, options.positional, true);});
+            freq_thread_overhead = pool.getDispatchTime();
+        }
 
         long par_freq_time = 0;
-        if(debug){
-            timer.start("par_freq_time");
-            for(int i=0; i<n_threads; i++){
-                count_tids.push_back(move(std::async(std::launch::async, count_chars, i)));
+        if(options.debug){
+            // chunks are all read before counting starts, so that reading is not included in the counting time
+            if(options.positional){
+                BlockScheduler read_scheduler(n_chunks, options.n_threads);
+                pool.run([&](int tid){count_chars(read_scheduler, tid, true, false);});
+                for(auto &res : count_res){
+                    read_time += res.read_time;
+                    read_ok &= res.read_ok;
+                }
             }
+            timer.start("par_freq_time");
+            pool.run([&](int tid){count_chars(count_scheduler, tid, false, true);});
         }
 
         long freq_time = 0;
-        for(auto &t : count_tids){
-            freq_time += t.get();
+        for(auto &res : count_res){
+            freq_time += res.freq_time;
+            read_time += res.read_time;
+            read_ok &= res.read_ok;
             
             // adding this line makes the threads faster for some reason
             // cout<<endl;
         }
 
-        if(debug){
+        if(options.debug){
             par_freq_time = timer.stop();
             logger.add_stat("freq_time", par_freq_time);
         }
 
-        // use array to store character counts
-        // can be directly indexed using ASCII characters
-        vector<int> count_vector(256, 0);
-
         timer.start("freq_join_overhead");
-        for(auto &c : partial_counts){
+        int n_nodes = 1;
+        for(int w=0; w<options.n_threads; w++){
+            n_nodes = std::max(n_nodes, pool.getNode(w) + 1);
+        }
+        // partial counts are first summed on each memory node by one of its threads, so that only one vector
+        // per node is read from a remote node
+        vector<vector<uint64_t>> node_counts;
+        if(n_nodes > 1){
+            node_counts.resize(n_nodes);
+            pool.run([&](int tid){
+                int node = pool.getNode(tid);
+                for(int w=0; w<tid; w++){
+                    if(pool.getNode(w) == node){
+                        return;
+                    }
+                }
+                node_counts[node].assign(256, 0);
+                for(int w=tid; w<options.n_threads; w++){
+                    if(pool.getNode(w) == node){
+                        for(int c=0; c<256; c++){
+                            node_counts[node][c] += partial_counts[w][c];
+                        }
+                    }
+                }
+            });
+        }
+        for(auto &c : n_nodes > 1 ? node_counts : partial_counts){
             for(int i=0; i<c.size(); i++)
             {
                 count_vector[i] += c[i];
@@ -308,85 +631,230 @@ int main(int argc, char* argv[]){
         long freq_join_overhead = timer.stop();
         
     elapsed_time = logger.stop();
+
+    if(!read_ok){
+        cout << "Could not read input file." << endl;
+        return -1;
+    }
     
     logger.add_stat("freq_thread_overhead", freq_thread_overhead);
     logger.add_stat("reading_input", read_time);
-    if(!debug){logger.add_stat("freq_time", freq_time);}
+    if(!options.debug){logger.add_stat("freq_time", freq_time);}
     logger.add_stat("freq_join_overhead", freq_join_overhead);
 
-    if(verbose){
+    if(options.verbose){
         cout << "Reading input and counting character frequency took " << elapsed_time << " real usecs." << endl;
         cout << "Reading input took " << read_time << " usecs." << endl;
         cout << "Counting characters took " << freq_time << " usecs in overall computation time between threads." << endl;
-        cout << "Overhead for starting threads for frequency gathering was " << freq_thread_overhead << " usecs." << endl;
+        cout << "Overhead for waking the threads for frequency gathering was " << freq_thread_overhead << " usecs." << endl;
         cout << "Joining partial frequency counts took " << freq_join_overhead << " usecs." << endl;
     }
     
     // create the huffman tree and table of encodings
     logger.start("huffman_tree_creation");
-        HuffmanTree ht(count_vector);
+        HuffmanTree ht(count_vector, options.max_code_length);
     elapsed_time = logger.stop();
 
-    if(verbose){
+    if(options.verbose){
         cout << "Creating the Huffman tree and extracting the code table took " << elapsed_time << " usecs." << endl;
+        // compare with the unrestricted codes to report the loss in compression
+        LengthLimitReport limit_report;
+        limit_report.add(ht, count_vector);
+        limit_report.print(cout, options.max_code_length);
     }
 
-    auto code_table = ht.getCodes();
+    // header of the encoded file, the codes used depend on its version
+    // a contiguous bitstream is stored as a single chunk, as in the sequential version
+    FileHeader header(options.header_version, options.contiguous ? 1 : n_chunks, count_vector, ht,
+                        options.header_version >= FileHeader::CANONICAL_64 && !options.contiguous ? chunk_size : 0);
+    header.setChecksums(options.checksums);
+    auto code_table = header.getCodes();
+    BitWriter writer(code_table);
 
     long encode_time = 0;
     long write_time = 0;
+    bool write_ok = true;
     // encode and write to file in chunks
     logger.start("encode_and_write");
 
-        vector<std::future<encoding_results>> encode_tids;
-        
+        // results of each thread
+        vector<encoding_results> encode_res(options.n_threads);
+
         timer.start("write");
-        std::ofstream output_file(output_filename, std::ios::binary);  
-        
+        // header, containing the number of chunks and the table of encodings
+        auto header_buf = header.serialize();
+
+        // the size of each chunk is known from its character counts, so the offsets of the chunks
+        // in the output file are computed before encoding
+        size_t chunk_header_size = header.serializeChunk(0, 0).size();
+        vector<uint64_t> chunk_offsets(n_chunks + 1);
+        // position of each chunk in the bitstream, only used for a contiguous bitstream
+        vector<uint64_t> bit_offsets(n_chunks + 1, 0);
+        vector<char> bitstream_header;
+        if(options.contiguous){
+            for(int i=0; i<n_chunks; i++){
+                bit_offsets[i+1] = bit_offsets[i] + writer.encoded_bits(chunk_counts[i]);
+            }
+            uint64_t n_bits = bit_offsets[n_chunks];
+            bitstream_header = header.serializeChunk(BitWriter::byte_size(n_bits), BitWriter::padding(n_bits));
+            // all the chunks share the position of the bitstream, the last offset is the end of the file
+            chunk_offsets.assign(n_chunks + 1, header_buf.size() + chunk_header_size);
+            chunk_offsets[n_chunks] += BitWriter::byte_size(n_bits);
+        }
+        else{
+            chunk_offsets[0] = header_buf.size();
+            for(int i=0; i<n_chunks; i++){
+                chunk_offsets[i+1] = chunk_offsets[i] + chunk_header_size
+                                    + header.storedSize(writer.encoded_bits(chunk_counts[i]), file_chunks[i].size);
+            }
+        }
+
+        // the output file is created with its final size, so that chunks can be written in any order
+        // when it is mapped in memory it is only created by the mapping
+        OutputFile output_file(options.mapped ? "" : options.output_filename);
         if(output_file.is_open()){
-            // write number of chunks          
-            output_file.write(reinterpret_cast<const char *>(&n_threads), sizeof(n_threads));
-            // write encoding table
-            // more efficient ways exist
-            for(auto &f : count_vector){
-                output_file.write(reinterpret_cast<const char *>(&f), sizeof(f));
+            write_ok = output_file.allocate(chunk_offsets[n_chunks])
+                        && output_file.write(0, header_buf.data(), header_buf.size())
+                        && output_file.write(header_buf.size(), bitstream_header.data(), bitstream_header.size());
+        }
+        std::unique_ptr<MappedOutputFile> mapped_output;
+        if(options.mapped && options.output_filename != ""){
+            mapped_output = std::make_unique<MappedOutputFile>(options.output_filename, chunk_offsets[n_chunks]);
+            write_ok = mapped_output->is_open();
+            if(write_ok){
+                std::copy(header_buf.begin(), header_buf.end(), mapped_output->data());
             }
-            write_time += timer.stop();
         }
-        
-        long encode_thread_overhead = 0;
-        for(int i=0; i<n_threads; i++){
-            timer.start("encode_thread_overhead");
-            encode_tids.push_back(move(std::async(std::launch::async, encode_chunk,
-                                            std::ref(code_table), std::ref(file_chunks[i]), i, std::ref(output_file),
-                                            std::ref(m), std::ref(cv))));
-            encode_thread_overhead += timer.stop();
+        char *mapped_data = write_ok && mapped_output != nullptr ? mapped_output->data() : nullptr;
+
+        // buffers of the asynchronous writer must hold the largest encoded chunk
+        std::unique_ptr<AsyncWriter> async_writer;
+        if(options.async && output_file.is_open()){
+            size_t max_buffer = 0;
+            for(int i=0; i<n_chunks; i++){
+                uint64_t skip = bit_offsets[i] % 8;
+                max_buffer = std::max(max_buffer, options.contiguous ?
+                                BitWriter::buffer_size(bit_offsets[i+1] - bit_offsets[i] + skip) :
+                                chunk_header_size + std::max(BitWriter::buffer_size(writer.encoded_bits(chunk_counts[i])), file_chunks[i].size));
+            }
+            // each thread can encode a chunk while its previous one is written
+            async_writer = std::make_unique<AsyncWriter>(output_file, options.output_filename, 2 * options.n_threads, max_buffer, options.direct);
         }
+        write_time += timer.stop();
+
+        // function acting as body of thread to encode and write the chunks assigned by the scheduler
+        auto encode_chunks = [&](BlockScheduler &scheduler, int tid){
+            auto &res = encode_res[tid];
+            res = {0, 0, true};
+            int i;
+            while(scheduler.next(tid, i)){
+                auto chunk_res = options.contiguous ?
+                    encode_bits_at(writer, file_chunks[i], bit_offsets[i], bit_offsets[i+1], chunk_offsets[i], output_file, async_writer.get()) :
+                    encode_chunk(writer, file_chunks[i], chunk_counts[i], header, chunk_offsets[i], output_file, async_writer.get(), mapped_data);
+                res.encode_time += chunk_res.encode_time;
+                res.write_time += chunk_res.write_time;
+                res.write_ok &= chunk_res.write_ok;
+                res.shared_bytes.insert(res.shared_bytes.end(), chunk_res.shared_bytes.begin(), chunk_res.shared_bytes.end());
+            }
+        };
 
-        // wait for the threads to finish
-        for(int i=0; i<n_threads; i++){
-            auto res = encode_tids[i].get();
+        BlockScheduler encode_scheduler(n_chunks, options.n_threads);
+        pool.run([&](int tid){encode_chunks(encode_scheduler, tid);});
+        long encode_thread_overhead = pool.getDispatchTime();
+
+        // bytes shared between chunks of a contiguous bitstream are merged, bits of other chunks are 0 in each part
+        std::map<uint64_t, char> shared_bytes;
+        for(auto &res : encode_res){
             encode_time += res.encode_time;
             write_time += res.write_time;
+            write_ok &= res.write_ok;
+            for(auto &[pos, byte] : res.shared_bytes){
+                shared_bytes[pos] |= byte;
+            }
+        }
+        if(output_file.is_open()){
+            timer.start("write");
+            for(auto &[pos, byte] : shared_bytes){
+                write_ok &= output_file.write(chunk_offsets[0] + pos, &byte, 1);
+            }
+            write_time += timer.stop();
+        }
+
+        // the threads only queued their writes, the time spent waiting for them is reported separately
+        long write_wait = 0;
+        if(async_writer != nullptr){
+            timer.start("write_wait");
+            write_ok &= async_writer->finish();
+            write_wait = timer.stop();
         }
 
     elapsed_time = logger.stop();
+
+    if(!write_ok){
+        cout << "Could not write output file." << endl;
+        return -1;
+    }
     logger.add_stat("write", write_time);
-    if(!debug){logger.add_stat("encode", encode_time);}
+    if(!options.debug){logger.add_stat("encode", encode_time);}
     else{logger.add_stat("encode", elapsed_time);}
     logger.add_stat("encode_thread_overhead", encode_thread_overhead);
+    if(async_writer != nullptr){logger.add_stat("write_wait", write_wait);}
 
-    if(verbose){
+    if(options.verbose){
         cout << "Encoding and writing the file took " << elapsed_time << " usecs." << endl;
         cout << "Encoding the file took " << encode_time << " usecs." << endl;
         cout << "Writing encoded file took " << write_time << " usecs." << endl;
+        if(async_writer != nullptr){
+            cout << "Waiting for the asynchronous writes took " << write_wait << " usecs (io_uring: "
+                 << (async_writer->isAsync() ? "yes" : "no") << ", registered buffers: " << (async_writer->isRegistered() ? "yes" : "no")
+                 << ", direct: " << (async_writer->isDirect() ? "yes" : "no") << ")." << endl;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+
+    EncoderOptions options;
+    int exit_code;
+    if(!options.parse(argc, argv, exit_code)){
+        return exit_code;
+    }
+
+    // build path to save logs
+    // assumes input file ends in 3 letter long file format e.g. .txt
+    // the standard input is logged as stdin and batches as batch
+    string log_file = "./" + options.log_folder + "/par/" + std::to_string(options.n_threads) + "_"
+                        + (options.batch ? "batch.csv" : options.filename == "-" ? "stdin.csv" : options.filename);
+    log_file = log_file.substr(0, log_file.find_last_of('.'))+".csv";
+
+    Logger logger(log_file, options.n_threads);
+    Timer timer;
+    Timer tot_timer;
+    
+    // the threads are created once and reused by all the parallel phases, also when encoding in blocks
+    timer.start("thread_pool_creation");
+    ThreadPool &pool = ThreadPool::shared(options.n_threads, options.affinity);
+    logger.add_stat("thread_pool_creation", timer.stop());
+
+    // loop n_times
+    tot_timer.start("total");
+
+    int ret = options.streaming ? encode_stream(options, logger)
+                : options.batch ? encode_batch(options, logger)
+                : options.adaptive ? encode_adaptive(options, logger)
+                : options.block_size != 0 ? encode_blocks(options, logger)
+                : encode_in_memory(options, logger, pool);
+    if(ret != 0){
+        return ret;
     }
 
     logger.add_stat("total", tot_timer.stop());
-    if(log_folder != ""){
-        std::filesystem::create_directory("./" + log_folder);
-        std::filesystem::create_directory("./" + log_folder + "/par");
+    if(options.log_folder != ""){
+        std::filesystem::create_directory("./" + options.log_folder);
+        std::filesystem::create_directory("./" + options.log_folder + "/par");
         logger.write_logs(log_file);
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -15,58 +15,29 @@
 
 #include "logger.hpp"
 #include "huffman_tree.hpp"
+#include "bit_writer.hpp"
+#include "file_header.hpp"
+#include "stream_encoder.hpp"
+#include "adaptive_encoder.hpp"
+#include "output_file.hpp"
+#include "mapped_output_file.hpp"
+#include "pipe_encoder.hpp"
+#include "histogram.hpp"
+#include "encoder_options.hpp"
 
 using std::cout, std::clog, std::endl, std::string;
 
-void print_help(){
-    cout << "The program accepts the following arguments:" << endl;
-    cout << "\t -i path: path to the file to be encoded, required." << endl;
-    cout << "\t -o path: path where the encoded file has to be saved, required." << endl;
-    cout << "\t -v: set verbose." << endl;
-    cout << "\t -l: enable logging to file" << endl;
-}
-
 int main(int argc, char* argv[]){
 
-    string filename = "";
-    string output_filename = "";
-    int n_times = 1;
-    bool verbose = false;
-    string log_folder = "";
-
-    // parse command line arguments
-    int opt;
-
-    while ((opt = getopt(argc, argv, "hi:o:vl:")) != -1) {
-        switch (opt) {
-        case 'h':
-            print_help();
-            return 1;
-        case 'i':
-            filename = optarg;
-            break;
-        case 'o':
-            output_filename = optarg;
-            break;
-        case 'v':
-            verbose = true;
-            break;
-        case 'l':
-            log_folder = optarg;
-            break;
-        default:
-            print_help();
-            return 0;
-        }
+    // the sequential version encodes a single file with a single thread, options about threads, batches and writers are not accepted
+    EncoderOptions options("hi:o:vl:Lm:b:s:aMF:P:k");
+    int exit_code;
+    if(!options.parse(argc, argv, exit_code)){
+        return exit_code;
     }
 
-    if((filename == "") || !std::filesystem::exists(filename) || (output_filename == "")){
-        cout << "Input and output filenames are required or input file does not exist." << endl;
-        print_help();
-        return 0;
-    }
-
-    string log_file = "./" + log_folder + "/seq/" + filename;
+    // the standard input is logged as stdin
+    string log_file = "./" + options.log_folder + "/seq/" + (options.filename == "-" ? "stdin.csv" : options.filename);
     log_file = log_file.substr(0, log_file.find_last_of('.'))+".csv";
 
     Logger logger(log_file, 1);
@@ -74,165 +45,318 @@ int main(int argc, char* argv[]){
     long elapsed_time; 
 
     timer.start("total");
-    std::ifstream file(filename);
 
-    int filesize = std::filesystem::file_size(filename);
+    if(options.streaming){
+        // messages go to the standard error when the encoding is written to the standard output
+        std::ostream &info = options.output_filename == "-" ? clog : cout;
+        uint64_t stream_block_size = options.block_size == 0 ? FileHeader::DEFAULT_CHUNK_CHARS : options.block_size;
+        PipeEncoder encoder(options.filename, options.output_filename, stream_block_size, 1,
+                            options.latency == -1 ? PipeEncoder::DEFAULT_LATENCY : options.latency, options.max_code_length);
+        FileHeader header(stream_block_size);
+        header.setChecksums(options.checksums);
+
+        // the preloaded codes are built from all the characters of the file, counted in blocks
+        if(options.preload_filename != ""){
+            logger.start("preload");
+                std::vector<uint64_t> preload_counts;
+                StreamEncoder preload_stream(options.preload_filename, FileHeader::DEFAULT_CHUNK_CHARS, 1);
+                bool ok = preload_stream.count(preload_counts);
+                HuffmanTree preload_ht(preload_counts, options.max_code_length);
+                encoder.preload(preload_ht.getCodeLengths());
+            elapsed_time = logger.stop();
+            if(!ok){
+                info << "Could not read the file to build the preloaded codes from." << endl;
+                return -1;
+            }
+        }
 
-    // buffer to store the file
-    std::vector<unsigned char> file_str;
+        // single pass over the stream, each block is written as soon as it is encoded
+        logger.start("encode_and_write");
+            bool ok = encoder.encode(header);
+        elapsed_time = logger.stop();
+        logger.add_stat("reading_input", encoder.getReadTime());
+        logger.add_stat("freq_time", encoder.getFreqTime());
+        logger.add_stat("encode", encoder.getEncodeTime());
+        logger.add_stat("write", encoder.getWriteTime());
+        logger.add_stat("max_delay", encoder.getMaxDelay());
+
+        if(!ok){
+            info << "Could not encode input stream." << endl;
+            return -1;
+        }
+        if(options.verbose){
+            info << "Reading, counting, encoding and writing the stream took " << elapsed_time << " usecs." << endl;
+            info << encoder.getNTables() << " tables of codes were written for " << encoder.getNBlocks() << " blocks." << endl;
+            info << "The longest time from the arrival of a block to the end of its write was " << encoder.getMaxDelay() << " usecs." << endl;
+            encoder.getLimitReport().print(info, options.max_code_length);
+            info << "Stream is " << encoder.getNChars() << " characters long" << endl;
+            info<<endl<<endl;
+        }
+        logger.add_stat("total", timer.stop());
+        if(options.log_folder != ""){
+            std::filesystem::create_directory("./" + options.log_folder);
+            std::filesystem::create_directory("./" + options.log_folder + "/seq");
+            logger.write_logs(log_file);
+        }
+        return 0;
+    }
 
-    long read_and_count_time = 0;
-    // read file
-    logger.start("reading_input");
-        file_str.resize(filesize);
-        file.read(reinterpret_cast<char *>(&file_str[0]), filesize);
-        file.close();
-    elapsed_time = logger.stop();
-    read_and_count_time += elapsed_time;
-    
-    if(verbose){
-        cout << "Reading input file took " << elapsed_time << " usecs." << endl;
+    if(options.adaptive){
+        AdaptiveEncoder encoder(options.filename, options.block_size, 1, options.max_code_length);
+        FileHeader header(encoder.getNBlocks(), options.filesize, options.block_size);
+        header.setChecksums(options.checksums);
+
+        // single pass over the blocks, each one is counted, encoded and written before reading the next one
+        logger.start("encode_and_write");
+            auto header_buf = header.serialize();
+            OutputFile output_file(options.output_filename);
+            bool ok = output_file.is_open() && output_file.write(0, header_buf.data(), header_buf.size())
+                        && encoder.encode(header, output_file, header_buf.size());
+        elapsed_time = logger.stop();
+        logger.add_stat("reading_input", encoder.getReadTime());
+        logger.add_stat("freq_time", encoder.getFreqTime());
+        logger.add_stat("encode", encoder.getEncodeTime());
+        logger.add_stat("write", encoder.getWriteTime());
+
+        if(!ok){
+            cout << "Could not encode input file." << endl;
+            return -1;
+        }
+        if(options.verbose){
+            cout << "Reading, counting, encoding and writing the file took " << elapsed_time << " usecs." << endl;
+            cout << encoder.getNTables() << " tables of codes were written for " << encoder.getNBlocks() << " blocks." << endl;
+            encoder.getLimitReport().print(cout, options.max_code_length);
+            cout << "File is " << options.filesize << " characters long" << endl;
+            cout << "Encoded file is " << std::filesystem::file_size(options.output_filename) << " bytes" << endl;
+            cout<<endl<<endl;
+        }
+        logger.add_stat("total", timer.stop());
+        if(options.log_folder != ""){
+            std::filesystem::create_directory("./" + options.log_folder);
+            std::filesystem::create_directory("./" + options.log_folder + "/seq");
+            logger.write_logs(log_file);
+        }
+        return 0;
     }
 
+    // buffer to store the file, unused when encoding in blocks
+    std::vector<unsigned char> file_str;
+
     // use array to store character counts
     // can be directly indexed using ASCII characters
-    std::vector<int> count_vector(256, 0);
-
-    logger.start("freq_time");
-        for(int i=0; i<file_str.size(); i++)
-        {
-            count_vector[int(file_str[i])]++;
+    std::vector<uint64_t> count_vector(256, 0);
+
+    // only used when encoding in blocks
+    StreamEncoder stream(options.filename, options.block_size == 0 ? 1 : options.block_size, 1);
+
+    if(options.block_size != 0){
+        // counting pass over the blocks, the file is read again while encoding
+        // when sampling only the sample is read and the file is read once
+        logger.start("read_and_count");
+            bool ok = options.sample_size != 0 ? stream.sample(options.sample_size, count_vector) : stream.count(count_vector);
+        elapsed_time = logger.stop();
+        logger.add_stat("reading_input", stream.getReadTime());
+        logger.add_stat("freq_time", stream.getComputeTime());
+
+        if(!ok){
+            cout << "Could not read input file." << endl;
+            return -1;
+        }
+        if(options.verbose){
+            cout << "Reading input and counting character frequency took " << elapsed_time << " usecs." << endl;
+        }
+    }
+    else{
+        std::ifstream file(options.filename);
+        long read_and_count_time = 0;
+        // read file
+        logger.start("reading_input");
+            file_str.resize(options.filesize);
+            file.read(reinterpret_cast<char *>(&file_str[0]), options.filesize);
+            file.close();
+        elapsed_time = logger.stop();
+        read_and_count_time += elapsed_time;
+        
+        if(options.verbose){
+            cout << "Reading input file took " << elapsed_time << " usecs." << endl;
         }
 
-    elapsed_time = logger.stop();
-    read_and_count_time += elapsed_time;
+        logger.start("freq_time");
+            count_bytes(file_str.data(), file_str.size(), count_vector);
+        elapsed_time = logger.stop();
+        read_and_count_time += elapsed_time;
 
-    logger.add_stat("read_and_count", read_and_count_time);
+        logger.add_stat("read_and_count", read_and_count_time);
 
-    if(verbose){
-        cout << "Gathering character frequency took " << elapsed_time << " usecs." << endl;
+        if(options.verbose){
+            cout << "Gathering character frequency took " << elapsed_time << " usecs." << endl;
+        }
     }
 
     
     // create the huffman tree and table of encodings
     logger.start("huffman_tree_creation");
-        HuffmanTree ht(count_vector);
+        HuffmanTree ht(count_vector, options.max_code_length);
     elapsed_time = logger.stop();
     
-    if(verbose){
+    if(options.verbose){
         cout << "Creating the Huffman tree and extracting the code table took " << elapsed_time << " usecs." << endl;
+        // compare with the unrestricted codes to report the loss in compression
+        LengthLimitReport limit_report;
+        limit_report.add(ht, count_vector);
+        limit_report.print(cout, options.max_code_length);
     }
 
-    auto code_table = ht.getCodes();
+    // there for consistency with parallel version, each block is a chunk when encoding in blocks
+    const int n_chunks = options.block_size == 0 ? 1 : stream.getNBlocks();
+
+    // header of the encoded file, the codes used depend on its version
+    FileHeader header(options.header_version, n_chunks, count_vector, ht, options.block_size);
+    header.setChecksums(options.checksums);
+    // estimated frequencies do not add up to the length of the file
+    header.setNChars(options.filesize);
+    auto code_table = header.getCodes();
 
     long encode_and_write_time = 0;
+    long write_time = 0;
+
+    // object packing the encodings into the buffer
+    BitWriter writer(code_table);
+
+    if(options.block_size != 0){
+        std::ofstream output_file(options.output_filename, std::ios::binary);
+
+        // encoding pass, blocks are read, encoded and written one at a time
+        logger.start("encode_and_write");
+            auto header_buf = header.serialize();
+            output_file.write(header_buf.data(), header_buf.size());
+            // when sampling, the characters are also counted to report the loss in compression
+            std::vector<uint64_t> exact_counts;
+            bool ok = stream.encode(writer, header, output_file, options.verbose && options.sample_size != 0 ? &exact_counts : nullptr);
+            output_file.close();
+        elapsed_time = logger.stop();
+        logger.add_stat("reading_input", stream.getReadTime());
+        logger.add_stat("encode", stream.getComputeTime());
+        logger.add_stat("write", stream.getWriteTime());
+
+        if(!ok){
+            cout << "Could not encode input file." << endl;
+            return -1;
+        }
+        if(options.verbose && options.sample_size != 0){
+            // compare with the codes built from the exact frequencies to report the loss in compression
+            HuffmanTree exact_ht(exact_counts, options.max_code_length);
+            uint64_t sampled_bits = ht.encodedBits(exact_counts);
+            uint64_t exact_bits = exact_ht.encodedBits(exact_counts);
+            double loss = exact_bits == 0 ? 0 : 100.0 * (sampled_bits - exact_bits) / exact_bits;
+            cout << "Building the codes from a sample makes the encoding " << (sampled_bits - exact_bits) / 8
+                 << " bytes larger (" << loss << "% of the encoding with exact counts)." << endl;
+        }
+        if(options.verbose){
+            cout << "Reading, encoding and writing the file took " << elapsed_time << " usecs." << endl;
+            cout << "File is " << options.filesize << " characters long" << endl;
+            cout << "Encoded file is " << std::filesystem::file_size(options.output_filename) << " bytes" << endl;
+            cout<<endl<<endl;
+        }
+        logger.add_stat("total", timer.stop());
+        if(options.log_folder != ""){
+            std::filesystem::create_directory("./" + options.log_folder);
+            std::filesystem::create_directory("./" + options.log_folder + "/seq");
+            logger.write_logs(log_file);
+        }
+        return 0;
+    }
 
+    // the exact size of the encoding is known from the character counts
+    // so the buffer is allocated only once
+    uint64_t max_bits = writer.encoded_bits(count_vector);
     std::vector<char> buffer_vec;
-    buffer_vec.reserve(file_str.size()*2/3);
-    // current size of the buffer
-    int buf_len = 0;
-    char buffer = 0;
-    // remaining bits to save to buffer for currently considered character
-    // is initialized with the length of the encoding for each character
-    int remaining;
-    // code of the character, stored as an int
-    int code;
-    // size of a single buffer
-    const int max_size = sizeof(char) * 8;
-
-    // there for consistency with parallel version
-    const int n_chunks = 1;
-    // actual encoding of the file
-    // encoding is stored into a vector of chars
-    logger.start("encode");
-        for(auto &c : file_str){
-            auto code_pair = code_table[int(c)];
-            code = code_pair.second;
-            remaining = code_pair.first;;
-            // loop saving the encoding of the character to the buffer
-            while(remaining != 0){
-                // buffer has reached maximum size
-                if(buf_len==max_size){
-                    // flush buffer to vector
-                    buffer_vec.push_back(buffer);
-                    // reset buffer
-                    buffer = 0;
-                    buf_len = 0;
-                }
-                // buffer has enough space to store the rest of the encoding
-                // of the current character
-                if(buf_len+remaining <= max_size){
-                    // shift buffer and add code to the end
-                    buffer = (buffer << remaining) | code;
-                    //update buffer size
-                    buf_len += remaining;
-                    remaining = 0;
-                }
-                // buffer does not have enough space to store the rest of the encoding
-                // of the current character 
-                else{
-                    int shift = max_size-buf_len;
-                    // shift buffer to left and shift encoding to right
-                    buffer = (buffer << shift) | (code >> (remaining - shift));
-                    remaining -= shift;
-                    buf_len = max_size;
-                }
+    char *buffer;
+
+    // when the output file is mapped in memory, it is created with its final size and the headers are copied
+    // before encoding, so that the file is encoded in place. The header of the chunk is copied again after
+    // encoding when it stores the checksum of the encoding
+    std::unique_ptr<MappedOutputFile> mapped_output;
+    if(options.mapped){
+        logger.start("write");
+            auto header_buf = header.serialize();
+            auto chunk_header = header.serializeChunk(BitWriter::byte_size(max_bits), BitWriter::padding(max_bits));
+            mapped_output = std::make_unique<MappedOutputFile>(options.output_filename,
+                                header_buf.size() + chunk_header.size() + BitWriter::byte_size(max_bits));
+            if(mapped_output->is_open()){
+                std::copy(header_buf.begin(), header_buf.end(), mapped_output->data());
+                std::copy(chunk_header.begin(), chunk_header.end(), mapped_output->data() + header_buf.size());
             }
-            
+        write_time = logger.stop();
+        encode_and_write_time += write_time;
+        if(!mapped_output->is_open()){
+            cout << "Could not write output file." << endl;
+            return -1;
         }
+        buffer = mapped_output->data() + header_buf.size() + chunk_header.size();
+    }
+    else{
+        buffer_vec.resize(BitWriter::buffer_size(max_bits));
+        buffer = buffer_vec.data();
+    }
 
-        // flush buffer if necessary and add padding bits to the end
-        if(buf_len!=0){
-            buffer_vec.push_back(buffer << (max_size-buf_len));
-        }
+    // actual encoding of the file
+    // encoding is stored into a vector of chars, or in the mapping without writing past its end
+    logger.start("encode");
+        uint64_t n_bits = writer.encode(file_str.data(), file_str.size(), buffer, 0, options.mapped);
     elapsed_time = logger.stop();
     encode_and_write_time += elapsed_time;
 
-    if(verbose){
+    if(options.verbose){
         cout << "Encoding the file took " << elapsed_time << " usecs." << endl;
     }
-    
-    // number of bits of padding required
-    char ending_padding = max_size - buf_len;
-
-    // number of buffers required to store the encoding
-    int chunk_byte_size = buffer_vec.size();
 
-    std::ofstream output_file(output_filename, std::ios::binary);
-
-    logger.start("write");
-        // write number of chunks
-        output_file.write(reinterpret_cast<const char *>(&n_chunks), sizeof(n_chunks));
-
-        // write encoding table
-        // more efficient ways exist
-        for(auto &f : count_vector){
-            output_file.write(reinterpret_cast<const char *>(&f), sizeof(f));
-        }
-
-        // write size of chunk
-        output_file.write(reinterpret_cast<const char *>(&chunk_byte_size), sizeof(chunk_byte_size));
-        // write number of padding bits
-        output_file.write(&ending_padding, 1);
-        // write the encoded binary
-        output_file.write(buffer_vec.data(), buffer_vec.size());
-    elapsed_time = logger.stop();
-    encode_and_write_time += elapsed_time;
+    // number of bits of padding required
+    char ending_padding = BitWriter::padding(n_bits);
+
+    // number of bytes required to store the encoding
+    uint64_t chunk_byte_size = BitWriter::byte_size(n_bits);
+
+    // the mapped output file already holds the encoding, the checksum is computed while it is still in cache
+    if(options.mapped && options.checksums){
+        logger.start("write");
+            auto chunk_header = header.serializeChunk(chunk_byte_size, ending_padding, nullptr, 0, buffer);
+            std::copy(chunk_header.begin(), chunk_header.end(), buffer - chunk_header.size());
+        elapsed_time = logger.stop();
+        write_time += elapsed_time;
+        encode_and_write_time += elapsed_time;
+    }
+    if(!options.mapped){
+        std::ofstream output_file(options.output_filename, std::ios::binary);
+
+        logger.start("write");
+            // write header, containing the number of chunks and the table of encodings
+            auto header_buf = header.serialize();
+            output_file.write(header_buf.data(), header_buf.size());
+
+            // write size of chunk and number of padding bits
+            auto chunk_header = header.serializeChunk(chunk_byte_size, ending_padding, nullptr, 0, buffer_vec.data());
+            output_file.write(chunk_header.data(), chunk_header.size());
+            // write the encoded binary
+            output_file.write(buffer_vec.data(), chunk_byte_size);
+        write_time = logger.stop();
+        encode_and_write_time += write_time;
+    }
     logger.add_stat("encode_and_write", encode_and_write_time);
-    if(verbose){
-        cout << "Writing encoded file took " << elapsed_time << " usecs." << endl;
+    if(options.verbose){
+        cout << (options.mapped ? "Creating and mapping the" : "Writing") << " encoded file took " << write_time << " usecs." << endl;
     }
 
-    if(verbose){
+    if(options.verbose){
         cout << "File is " << file_str.size() << " characters long" <<endl;
         cout << "Encoded file is " << chunk_byte_size << " bytes" << endl;
         cout<<endl<<endl;
     }
     elapsed_time = timer.stop();
     logger.add_stat("total", elapsed_time);
-    if(log_folder != ""){
-        std::filesystem::create_directory("./" + log_folder);
-        std::filesystem::create_directory("./" + log_folder + "/seq");
+    if(options.log_folder != ""){
+        std::filesystem::create_directory("./" + options.log_folder);
+        std::filesystem::create_directory("./" + options.log_folder + "/seq");
         logger.write_logs(log_file);
     }
     return 0;
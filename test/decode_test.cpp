@@ -27,11 +27,16 @@ int main(int argc, char* argv[]){
     int n_chunks;
     std::vector<int> count_vector(256);
     input_file.read(reinterpret_cast<char *>(&n_chunks), sizeof(n_chunks));
+    // only the legacy header is supported, versioned headers start with "HCF"
+    if(std::memcmp(&n_chunks, "HCF", 3) == 0){
+        cout << "Only files with the legacy header are supported, use hc_decode.out instead." << endl;
+        return -1;
+    }
     for(int i=0;i<256;i++){
         input_file.read(reinterpret_cast<char *>(&(count_vector[i])), sizeof(count_vector[i]));
     }
 
-    HuffmanTree ht = HuffmanTree(count_vector);
+    HuffmanTree ht = HuffmanTree(std::vector<uint64_t>(count_vector.begin(), count_vector.end()));
     std::ofstream output_file(output_filename, std::ios::binary);
 
 